@@ -0,0 +1,63 @@
+#include <stdarg.h>
+#include "Arduino.h"
+
+uint64_t NativeClock::iNowUs = 0;
+
+uint8_t NativeGpio::iLevel[NATIVE_NUM_OF_PINS];
+void ( *NativeGpio::iHandler[NATIVE_NUM_OF_PINS] )();
+uint8_t NativeGpio::iMode[NATIVE_NUM_OF_PINS];
+
+HardwareSerial Serial;
+
+void NativeGpio::Drive( const uint8_t aPin, const uint8_t aLevel )
+{
+    if ( aPin >= NATIVE_NUM_OF_PINS )
+    {
+        return;
+    }
+
+    const uint8_t old_level = iLevel[aPin];
+    const uint8_t new_level = aLevel ? HIGH : LOW;
+
+    iLevel[aPin] = new_level;
+
+    if ( ( iHandler[aPin] == nullptr ) || ( old_level == new_level ) )
+    {
+        return;
+    }
+
+    // Fire the handler only on the edge it was attached for
+    const bool rising = ( new_level == HIGH );
+
+    if ( ( iMode[aPin] == CHANGE ) ||
+         ( iMode[aPin] == RISING && rising ) ||
+         ( iMode[aPin] == FALLING && !rising ) )
+    {
+        iHandler[aPin]();
+    }
+}
+
+size_t HardwareSerial::printf( const char *aFormat, ... )
+{
+    if ( iMuted )
+    {
+        return 0;
+    }
+
+    va_list args;
+    va_start( args, aFormat );
+    const int written = vprintf( aFormat, args );
+    va_end( args );
+
+    return ( written > 0 ) ? written : 0;
+}
+
+size_t HardwareSerial::print( const char *aStr )
+{
+    return printf( "%s", aStr );
+}
+
+size_t HardwareSerial::print( char aChar )
+{
+    return printf( "%c", aChar );
+}
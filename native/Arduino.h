@@ -0,0 +1,231 @@
+#ifndef __NATIVE_ARDUINO_H__
+#define __NATIVE_ARDUINO_H__
+
+/**
+ * Host (native) replacement of the Arduino core used to build and benchmark
+ * the sensor/telemetry core on Linux. Time is virtual: it only advances when
+ * delay() is called, when a simulated bus transaction happens or when the
+ * harness calls NativeClock::Advance(), so runs are fully deterministic.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+
+#define HIGH            0x1
+#define LOW             0x0
+
+#define INPUT           0x01
+#define OUTPUT          0x02
+#define INPUT_PULLUP    0x05
+
+#define RISING          0x01
+#define FALLING         0x02
+#define CHANGE          0x03
+
+#define BUILTIN_LED     2
+
+#define NATIVE_NUM_OF_PINS  40
+
+class NativeClock
+{
+    /**
+     * Virtual time since start of the simulation in microseconds
+    */
+    static uint64_t iNowUs;
+
+    public:
+        /**
+         * Returns current virtual time
+         *
+         * @return virtual time in microseconds
+        */
+        static uint64_t NowUs()
+        {
+            return iNowUs;
+        }
+
+        /**
+         * Moves virtual time forward
+         *
+         * @param aUs number of microseconds to advance
+        */
+        static void Advance( const uint64_t aUs )
+        {
+            iNowUs += aUs;
+        }
+
+        /**
+         * Rewinds virtual time to zero
+        */
+        static void Reset()
+        {
+            iNowUs = 0;
+        }
+};
+
+class NativeGpio
+{
+    /**
+     * Levels of simulated GPIO pins
+    */
+    static uint8_t iLevel[NATIVE_NUM_OF_PINS];
+
+    /**
+     * Handlers attached to simulated GPIO pins
+    */
+    static void ( *iHandler[NATIVE_NUM_OF_PINS] )();
+
+    /**
+     * Edge modes of attached handlers
+    */
+    static uint8_t iMode[NATIVE_NUM_OF_PINS];
+
+    public:
+        /**
+         * Drives a simulated input pin and fires an attached handler on a matching edge
+         *
+         * @param aPin pin number
+         * @param aLevel new level of the pin
+        */
+        static void Drive( const uint8_t aPin, const uint8_t aLevel );
+
+        static uint8_t Read( const uint8_t aPin )
+        {
+            return ( aPin < NATIVE_NUM_OF_PINS ) ? iLevel[aPin] : LOW;
+        }
+
+        static void Write( const uint8_t aPin, const uint8_t aLevel )
+        {
+            if ( aPin < NATIVE_NUM_OF_PINS )
+            {
+                iLevel[aPin] = aLevel ? HIGH : LOW;
+            }
+        }
+
+        static void Attach( const uint8_t aPin, void ( *aHandler )(), const uint8_t aMode )
+        {
+            if ( aPin < NATIVE_NUM_OF_PINS )
+            {
+                iHandler[aPin] = aHandler;
+                iMode[aPin] = aMode;
+            }
+        }
+
+        static void Detach( const uint8_t aPin )
+        {
+            Attach( aPin, nullptr, 0 );
+        }
+};
+
+class HardwareSerial
+{
+    /**
+     * Output is suppressed when the serial port is muted
+    */
+    bool iMuted;
+
+    public:
+        HardwareSerial(): iMuted( false )
+        {
+        }
+
+        void begin( unsigned long )
+        {
+        }
+
+        void Mute( const bool aMuted )
+        {
+            iMuted = aMuted;
+        }
+
+        size_t printf( const char *aFormat, ... ) __attribute__( ( format( printf, 2, 3 ) ) );
+
+        size_t print( const char *aStr );
+        size_t print( char aChar );
+        size_t print( const std::string &aStr )     { return print( aStr.c_str() ); }
+        size_t print( int aValue )                  { return printf( "%d", aValue ); }
+        size_t print( unsigned int aValue )         { return printf( "%u", aValue ); }
+        size_t print( long aValue )                 { return printf( "%ld", aValue ); }
+        size_t print( unsigned long aValue )        { return printf( "%lu", aValue ); }
+        size_t print( double aValue )               { return printf( "%.2f", aValue ); }
+
+        size_t println()                            { return print( "\n" ); }
+
+        template<typename T>
+        size_t println( const T &aValue )
+        {
+            return print( aValue ) + println();
+        }
+};
+
+extern HardwareSerial Serial;
+
+inline unsigned long millis()
+{
+    return (unsigned long)( NativeClock::NowUs() / 1000 );
+}
+
+inline unsigned long micros()
+{
+    return (unsigned long) NativeClock::NowUs();
+}
+
+inline void delay( const uint32_t aMs )
+{
+    NativeClock::Advance( (uint64_t) aMs * 1000 );
+}
+
+inline void delayMicroseconds( const uint32_t aUs )
+{
+    NativeClock::Advance( aUs );
+}
+
+inline void pinMode( const uint8_t, const uint8_t )
+{
+}
+
+inline int digitalRead( const uint8_t aPin )
+{
+    return NativeGpio::Read( aPin );
+}
+
+inline void digitalWrite( const uint8_t aPin, const uint8_t aLevel )
+{
+    NativeGpio::Write( aPin, aLevel );
+}
+
+inline int digitalPinToInterrupt( const uint8_t aPin )
+{
+    return aPin;
+}
+
+inline void attachInterrupt( const uint8_t aPin, void ( *aHandler )(), const int aMode )
+{
+    NativeGpio::Attach( aPin, aHandler, aMode );
+}
+
+inline void detachInterrupt( const uint8_t aPin )
+{
+    NativeGpio::Detach( aPin );
+}
+
+inline long random( const long aMax )
+{
+    return ( aMax > 0 ) ? rand() % aMax : 0;
+}
+
+inline void randomSeed( const unsigned long aSeed )
+{
+    srand( aSeed );
+}
+
+#endif /* __NATIVE_ARDUINO_H__ */
@@ -0,0 +1,177 @@
+#include <string.h>
+#include "FS.h"
+#include "SPIFFS.h"
+
+fs::SPIFFSFS SPIFFS;
+
+namespace fs
+{
+
+size_t File::write( const uint8_t *aBuff, const size_t aSize )
+{
+    if ( ( iFs == nullptr ) || !iWritable )
+    {
+        return 0;
+    }
+
+    std::vector<uint8_t> &data = iFs->iFiles[iPath];
+    const size_t used = iFs->usedBytes();
+    const size_t free_bytes = ( used < iFs->iCapacity ) ? iFs->iCapacity - used : 0;
+
+    // Bytes overwritten in place take no new space
+    const size_t overwrite = ( iPosition < data.size() ) ? data.size() - iPosition : 0;
+    size_t size = aSize;
+
+    if ( size > overwrite + free_bytes )
+    {
+        size = overwrite + free_bytes;
+    }
+
+    if ( iPosition + size > data.size() )
+    {
+        data.resize( iPosition + size );
+    }
+
+    memcpy( &data[iPosition], aBuff, size );
+    iPosition += size;
+
+    iFs->iStats.iWrites++;
+    iFs->iStats.iBytesWritten += size;
+
+    return size;
+}
+
+size_t File::read( uint8_t *aBuff, const size_t aSize )
+{
+    if ( iFs == nullptr )
+    {
+        return 0;
+    }
+
+    const std::vector<uint8_t> &data = iFs->iFiles[iPath];
+    const size_t left = ( iPosition < data.size() ) ? data.size() - iPosition : 0;
+    const size_t size = ( aSize < left ) ? aSize : left;
+
+    if ( size != 0 )
+    {
+        memcpy( aBuff, &data[iPosition], size );
+    }
+
+    iPosition += size;
+
+    return size;
+}
+
+bool File::seek( const uint32_t aPosition )
+{
+    if ( ( iFs == nullptr ) || ( aPosition > size() ) )
+    {
+        return false;
+    }
+
+    iPosition = aPosition;
+
+    return true;
+}
+
+size_t File::size() const
+{
+    return ( iFs != nullptr ) ? iFs->iFiles[iPath].size() : 0;
+}
+
+File FS::open( const char *aPath, const char *aMode )
+{
+    const bool exists = iFiles.count( aPath ) != 0;
+
+    if ( aMode[0] == 'r' )
+    {
+        if ( !exists )
+        {
+            return File();
+        }
+
+        iStats.iOpens++;
+
+        return File( this, aPath, 0, false );
+    }
+
+    std::vector<uint8_t> &data = iFiles[aPath];
+
+    if ( aMode[0] == 'w' )
+    {
+        data.clear();
+    }
+
+    iStats.iOpens++;
+
+    return File( this, aPath, data.size(), true );
+}
+
+bool FS::remove( const char *aPath )
+{
+    if ( iFiles.erase( aPath ) == 0 )
+    {
+        return false;
+    }
+
+    iStats.iRemoves++;
+
+    return true;
+}
+
+bool FS::rename( const char *aFrom, const char *aTo )
+{
+    if ( !exists( aFrom ) )
+    {
+        return false;
+    }
+
+    iFiles[aTo].swap( iFiles[aFrom] );
+    iFiles.erase( aFrom );
+
+    return true;
+}
+
+size_t FS::usedBytes() const
+{
+    size_t used = 0;
+
+    for ( std::map<std::string, std::vector<uint8_t>>::const_iterator it = iFiles.begin(); it != iFiles.end(); ++it )
+    {
+        used += it->second.size();
+    }
+
+    return used;
+}
+
+void FS::Format()
+{
+    iFiles.clear();
+    iStats = FsStats();
+}
+
+bool FS::Corrupt( const char *aPath, const size_t aOffset, const uint8_t aMask )
+{
+    if ( !exists( aPath ) || ( aOffset >= iFiles[aPath].size() ) )
+    {
+        return false;
+    }
+
+    iFiles[aPath][aOffset] ^= aMask;
+
+    return true;
+}
+
+bool FS::Truncate( const char *aPath, const size_t aSize )
+{
+    if ( !exists( aPath ) || ( aSize > iFiles[aPath].size() ) )
+    {
+        return false;
+    }
+
+    iFiles[aPath].resize( aSize );
+
+    return true;
+}
+
+}
@@ -0,0 +1,166 @@
+#ifndef __NATIVE_FS_H__
+#define __NATIVE_FS_H__
+
+/**
+ * Host (native) replacement of the ESP32 FS library. Files live in memory, so
+ * a test can inspect wear, fill up the partition or damage stored bytes the
+ * way a power cut or a worn flash block would.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#define FILE_READ       "r"
+#define FILE_WRITE      "w"
+#define FILE_APPEND     "a"
+
+/**
+ * Default size of the simulated partition in bytes, same as the default
+ * SPIFFS partition of a 4 MB ESP32 module
+ */
+#define NATIVE_FS_DEFAULT_CAPACITY  0x170000
+
+namespace fs
+{
+
+class FS;
+
+class File
+{
+    FS *iFs;
+    std::string iPath;
+    size_t iPosition;
+    bool iWritable;
+
+    public:
+        File():
+            iFs( nullptr ),
+            iPosition( 0 ),
+            iWritable( false )
+        {
+        }
+
+        File( FS *aFs, const char *aPath, const size_t aPosition, const bool aWritable ):
+            iFs( aFs ),
+            iPath( aPath ),
+            iPosition( aPosition ),
+            iWritable( aWritable )
+        {
+        }
+
+        /**
+         * Writes at the current position, appended files always write at the end
+         *
+         * @return Number of bytes written, less when the partition is full
+        */
+        size_t write( const uint8_t *aBuff, const size_t aSize );
+
+        size_t read( uint8_t *aBuff, const size_t aSize );
+
+        bool seek( const uint32_t aPosition );
+
+        size_t position() const
+        {
+            return iPosition;
+        }
+
+        size_t size() const;
+
+        void close()
+        {
+            iFs = nullptr;
+        }
+
+        operator bool() const
+        {
+            return iFs != nullptr;
+        }
+};
+
+/**
+ * Wear counters of the simulated partition
+ */
+struct FsStats
+{
+    uint32_t iOpens;
+    uint32_t iWrites;
+    uint32_t iBytesWritten;
+    uint32_t iRemoves;
+};
+
+class FS
+{
+    friend class File;
+
+    std::map<std::string, std::vector<uint8_t>> iFiles;
+    size_t iCapacity;
+    FsStats iStats;
+
+    public:
+        FS():
+            iCapacity( NATIVE_FS_DEFAULT_CAPACITY ),
+            iStats()
+        {
+        }
+
+        /**
+         * Opens a file, modes "r", "w" (truncate) and "a" (append) are supported
+         *
+         * @return Invalid file if reading a file which does not exist
+        */
+        File open( const char *aPath, const char *aMode = FILE_READ );
+
+        bool exists( const char *aPath ) const
+        {
+            return iFiles.count( aPath ) != 0;
+        }
+
+        bool remove( const char *aPath );
+
+        bool rename( const char *aFrom, const char *aTo );
+
+        size_t totalBytes() const
+        {
+            return iCapacity;
+        }
+
+        size_t usedBytes() const;
+
+        /**
+         * Removes all files and clears counters, as after flashing an empty image
+        */
+        void Format();
+
+        void SetCapacity( const size_t aBytes )
+        {
+            iCapacity = aBytes;
+        }
+
+        const FsStats& GetStats() const
+        {
+            return iStats;
+        }
+
+        /**
+         * Flips bits of a stored byte
+         *
+         * @return False if the file is shorter
+        */
+        bool Corrupt( const char *aPath, const size_t aOffset, const uint8_t aMask );
+
+        /**
+         * Cuts a file short, as a power cut in the middle of a write would
+        */
+        bool Truncate( const char *aPath, const size_t aSize );
+};
+
+}
+
+using fs::File;
+using fs::FS;
+
+#endif /* __NATIVE_FS_H__ */
@@ -0,0 +1,81 @@
+#include "HeatshrinkEncoder.h"
+
+/**
+ * Longest copy of a back-reference
+ */
+#define ENCODER_MAX_MATCH   ( 1 << HEATSHRINK_LOOKAHEAD_BITS )
+
+/**
+ * Shortest copy worth a back-reference, 1 + W + L bits against 9 bits per literal
+ */
+#define ENCODER_MIN_MATCH   ( ( 1 + HEATSHRINK_WINDOW_BITS + HEATSHRINK_LOOKAHEAD_BITS ) / 9 + 1 )
+
+void HeatshrinkEncoder::PutBits( const uint16_t aValue, const uint8_t aCount )
+{
+    for ( uint8_t bit = aCount; bit > 0; --bit )
+    {
+        iBits = ( iBits << 1 ) | ( ( aValue >> ( bit - 1 ) ) & 1 );
+
+        if ( ++iBitCount == 8 )
+        {
+            iOut.push_back( iBits );
+            iBits = 0;
+            iBitCount = 0;
+        }
+    }
+}
+
+const std::vector<uint8_t>& HeatshrinkEncoder::Encode( const uint8_t *aIn, const size_t aSize )
+{
+    iOut.clear();
+    iBits = 0;
+    iBitCount = 0;
+
+    size_t pos = 0;
+
+    while ( pos < aSize )
+    {
+        const size_t lookahead = ( aSize - pos < ENCODER_MAX_MATCH ) ? aSize - pos : ENCODER_MAX_MATCH;
+        const size_t window = ( pos < HEATSHRINK_WINDOW_SIZE ) ? pos : HEATSHRINK_WINDOW_SIZE;
+        size_t best_length = 0;
+        size_t best_offset = 0;
+
+        // Nearest match first, a copy may overlap the bytes it produces
+        for ( size_t offset = 1; ( offset <= window ) && ( best_length < lookahead ); ++offset )
+        {
+            size_t length = 0;
+
+            while ( ( length < lookahead ) && ( aIn[pos - offset + length] == aIn[pos + length] ) )
+            {
+                length++;
+            }
+
+            if ( length > best_length )
+            {
+                best_length = length;
+                best_offset = offset;
+            }
+        }
+
+        if ( best_length >= ENCODER_MIN_MATCH )
+        {
+            PutBits( 0, 1 );
+            PutBits( best_offset - 1, HEATSHRINK_WINDOW_BITS );
+            PutBits( best_length - 1, HEATSHRINK_LOOKAHEAD_BITS );
+            pos += best_length;
+        }
+        else
+        {
+            PutBits( 1, 1 );
+            PutBits( aIn[pos], 8 );
+            pos++;
+        }
+    }
+
+    if ( iBitCount != 0 )
+    {
+        PutBits( 0, 8 - iBitCount );
+    }
+
+    return iOut;
+}
@@ -0,0 +1,38 @@
+#ifndef __NATIVE_HEATSHRINK_ENCODER_H__
+#define __NATIVE_HEATSHRINK_ENCODER_H__
+
+/**
+ * Host (native) heatshrink encoder producing streams for the decoder, same
+ * format and parameters as heatshrink -e -w 11 -l 4 used for firmware images.
+ * Matches are searched exhaustively, it is meant for test data, not speed.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "HeatshrinkDecoder.h"
+
+class HeatshrinkEncoder
+{
+    std::vector<uint8_t> iOut;
+    uint32_t iBits;
+    uint8_t iBitCount;
+
+    void PutBits( const uint16_t aValue, const uint8_t aCount );
+
+    public:
+        HeatshrinkEncoder():
+            iBits( 0 ),
+            iBitCount( 0 )
+        {
+        }
+
+        /**
+         * Compresses a whole buffer
+         *
+         * @return Compressed stream, the last byte padded with zero bits
+        */
+        const std::vector<uint8_t>& Encode( const uint8_t *aIn, const size_t aSize );
+};
+
+#endif /* __NATIVE_HEATSHRINK_ENCODER_H__ */
@@ -0,0 +1,32 @@
+#ifndef __NATIVE_SPIFFS_H__
+#define __NATIVE_SPIFFS_H__
+
+/**
+ * Host (native) replacement of the ESP32 SPIFFS library, see FS.h
+ */
+
+#include "FS.h"
+
+namespace fs
+{
+
+class SPIFFSFS : public FS
+{
+    public:
+        bool begin( const bool = false )
+        {
+            return true;
+        }
+
+        bool format()
+        {
+            Format();
+            return true;
+        }
+};
+
+}
+
+extern fs::SPIFFSFS SPIFFS;
+
+#endif /* __NATIVE_SPIFFS_H__ */
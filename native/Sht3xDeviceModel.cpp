@@ -0,0 +1,402 @@
+#include <ctype.h>
+#include "Sht3xDeviceModel.h"
+
+Sht3xDeviceModel::Sht3xDeviceModel():
+    iRawTemp( 0 ),
+    iRawHum( 0 ),
+    iFrame{},
+    iFrameValid( false ),
+    iMeasuring( false ),
+    iReadyAtUs( 0 ),
+    iClkStretch( false ),
+    iPeriodUs( 0 ),
+    iNextPeriodicUs( 0 ),
+    iPeriodicRep( eHigh ),
+    iFetchPending( false ),
+    iBusyUntilUs( 0 ),
+    iExtraDelayUs( 0 ),
+    iNacksToInject( 0 ),
+    iCrcErrorsToInject( 0 ),
+    iTracePos( 0 ),
+    iRecording( false ),
+    iStats{}
+{
+    SetTemperature( 23.0f );
+    SetHumidity( 45.0f );
+}
+
+uint8_t Sht3xDeviceModel::Crc( const uint8_t *aData, const size_t aSize )
+{
+    uint8_t crc = 0xFF;
+
+    for ( size_t byte = 0; byte < aSize; ++byte )
+    {
+        crc ^= aData[byte];
+
+        for ( uint8_t bit = 0; bit < 8; ++bit )
+        {
+            crc = ( crc & 0x80 ) ? (uint8_t)( ( crc << 1 ) ^ 0x31 ) : (uint8_t)( crc << 1 );
+        }
+    }
+
+    return crc;
+}
+
+uint64_t Sht3xDeviceModel::MeasurementTimeUs( const Repeatability aRep )
+{
+    switch ( aRep )
+    {
+    case eLow:
+        return SHT3X_MEAS_LOW_REP_US;
+    case eMedium:
+        return SHT3X_MEAS_MEDIUM_REP_US;
+    default:
+        return SHT3X_MEAS_HIGH_REP_US;
+    }
+}
+
+void Sht3xDeviceModel::SetTemperature( const float aTemp )
+{
+    // Inverse of T = -45 + 175 * raw / (2^16 - 1)
+    const float raw = ( aTemp + 45.0f ) * 65535.0f / 175.0f + 0.5f;
+
+    iRawTemp = ( raw <= 0.0f ) ? 0 : ( raw >= 65535.0f ) ? 65535 : (uint16_t) raw;
+}
+
+void Sht3xDeviceModel::SetHumidity( const float aHum )
+{
+    // Inverse of RH = 100 * raw / (2^16 - 1)
+    const float raw = aHum * 65535.0f / 100.0f + 0.5f;
+
+    iRawHum = ( raw <= 0.0f ) ? 0 : ( raw >= 65535.0f ) ? 65535 : (uint16_t) raw;
+}
+
+void Sht3xDeviceModel::LatchFrame()
+{
+    iFrame[0] = iRawTemp >> 8;
+    iFrame[1] = iRawTemp & 0xFF;
+    iFrame[2] = Crc( &iFrame[0], 2 );
+    iFrame[3] = iRawHum >> 8;
+    iFrame[4] = iRawHum & 0xFF;
+    iFrame[5] = Crc( &iFrame[3], 2 );
+
+    if ( iCrcErrorsToInject > 0 )
+    {
+        iCrcErrorsToInject--;
+        iFrame[5] ^= 0xFF;
+    }
+
+    iFrameValid = true;
+}
+
+void Sht3xDeviceModel::StartMeasurement( const Repeatability aRep, const bool aClkStretch )
+{
+    iMeasuring = true;
+    iClkStretch = aClkStretch;
+    iFrameValid = false;
+    iReadyAtUs = NativeClock::NowUs() + MeasurementTimeUs( aRep ) + iExtraDelayUs;
+}
+
+void Sht3xDeviceModel::UpdatePeriodic()
+{
+    const uint64_t now = NativeClock::NowUs();
+
+    if ( iMeasuring && ( now >= iReadyAtUs ) )
+    {
+        iMeasuring = false;
+        LatchFrame();
+    }
+
+    if ( ( iPeriodUs != 0 ) && ( now >= iNextPeriodicUs ) )
+    {
+        // Newest result overwrites an unread one, skipped periods are lost
+        LatchFrame();
+
+        while ( iNextPeriodicUs <= now )
+        {
+            iNextPeriodicUs += iPeriodUs;
+        }
+    }
+}
+
+bool Sht3xDeviceModel::ExecuteCommand( const uint16_t aCmd )
+{
+    const uint8_t msb = aCmd >> 8;
+    const uint8_t lsb = aCmd & 0xFF;
+
+    // Periodic mode accepts only fetch, break and soft reset
+    if ( ( iPeriodUs != 0 ) && ( aCmd != 0xE000 ) && ( aCmd != 0x3093 ) && ( aCmd != 0x30A2 ) )
+    {
+        return false;
+    }
+
+    switch ( aCmd )
+    {
+    case 0x2C06: StartMeasurement( eHigh, true );       return true;
+    case 0x2C0D: StartMeasurement( eMedium, true );     return true;
+    case 0x2C10: StartMeasurement( eLow, true );        return true;
+    case 0x2400: StartMeasurement( eHigh, false );      return true;
+    case 0x240B: StartMeasurement( eMedium, false );    return true;
+    case 0x2416: StartMeasurement( eLow, false );       return true;
+    case 0xE000:
+        iFetchPending = true;
+        return true;
+    case 0x3093:
+        iPeriodUs = 0;
+        iFetchPending = false;
+        return true;
+    case 0x30A2:
+        iPeriodUs = 0;
+        iMeasuring = false;
+        iFrameValid = false;
+        iFetchPending = false;
+        iBusyUntilUs = NativeClock::NowUs() + SHT3X_SOFT_RESET_US;
+        return true;
+    case 0x2B32:
+        // ART mode acquires at 4 Hz
+        iPeriodicRep = eHigh;
+        iPeriodUs = 250000;
+        break;
+    default:
+        break;
+    }
+
+    if ( iPeriodUs == 0 )
+    {
+        static const struct
+        {
+            uint8_t iMsb;
+            uint32_t iPeriodMs;
+            uint8_t iLsb[3];
+        } periodic[] =
+        {
+            { 0x20, 2000, { 0x2F, 0x24, 0x32 } },
+            { 0x21, 1000, { 0x2D, 0x26, 0x30 } },
+            { 0x22, 500,  { 0x2B, 0x20, 0x36 } },
+            { 0x23, 250,  { 0x29, 0x22, 0x34 } },
+            { 0x27, 100,  { 0x2A, 0x21, 0x37 } }
+        };
+
+        for ( const auto &mode : periodic )
+        {
+            for ( uint8_t rep = eLow; ( mode.iMsb == msb ) && ( rep <= eHigh ); ++rep )
+            {
+                if ( mode.iLsb[rep] == lsb )
+                {
+                    iPeriodicRep = (Repeatability) rep;
+                    iPeriodUs = (uint64_t) mode.iPeriodMs * 1000;
+                }
+            }
+        }
+    }
+
+    if ( iPeriodUs != 0 )
+    {
+        // First result is available after one conversion
+        iFrameValid = false;
+        iFetchPending = false;
+        iNextPeriodicUs = NativeClock::NowUs() + MeasurementTimeUs( iPeriodicRep ) + iExtraDelayUs;
+        return true;
+    }
+
+    return false;
+}
+
+bool Sht3xDeviceModel::OnWrite( const uint8_t *aData, const size_t aSize )
+{
+    Record( 'W', aData, aSize );
+
+    // Replayed trace dictates the expected command
+    if ( iTracePos < iTrace.size() && iTrace[iTracePos].iKind == eTraceWrite )
+    {
+        const TraceEntry &entry = iTrace[iTracePos++];
+
+        if ( ( entry.iSize != aSize ) || ( memcmp( entry.iData, aData, aSize ) != 0 ) )
+        {
+            iStats.iTraceMismatches++;
+        }
+    }
+
+    if ( iNacksToInject > 0 )
+    {
+        iNacksToInject--;
+        iStats.iNacks++;
+        return false;
+    }
+
+    UpdatePeriodic();
+
+    // Device does not acknowledge while measuring in single shot mode or while resetting
+    if ( ( aSize != 2 ) || iMeasuring || ( NativeClock::NowUs() < iBusyUntilUs ) )
+    {
+        iStats.iNacks++;
+        return false;
+    }
+
+    iStats.iCommands++;
+
+    if ( !ExecuteCommand( (uint16_t)( aData[0] << 8 | aData[1] ) ) )
+    {
+        iStats.iUnknownCommands++;
+        iStats.iNacks++;
+        return false;
+    }
+
+    return true;
+}
+
+size_t Sht3xDeviceModel::OnRead( uint8_t *aData, const size_t aSize )
+{
+    const size_t size = ( aSize < SHT3X_FRAME_SIZE ) ? aSize : SHT3X_FRAME_SIZE;
+
+    // Replayed trace answers reads while it lasts
+    if ( iTracePos < iTrace.size() && iTrace[iTracePos].iKind != eTraceWrite )
+    {
+        const TraceEntry &entry = iTrace[iTracePos++];
+
+        if ( entry.iKind == eTraceNack )
+        {
+            iStats.iNacks++;
+            Record( 'N', nullptr, 0 );
+            return 0;
+        }
+
+        const size_t count = ( entry.iSize < size ) ? entry.iSize : size;
+        memcpy( aData, entry.iData, count );
+        iStats.iFrames++;
+        Record( 'R', aData, count );
+        return count;
+    }
+
+    if ( iNacksToInject > 0 )
+    {
+        iNacksToInject--;
+        iStats.iNacks++;
+        Record( 'N', nullptr, 0 );
+        return 0;
+    }
+
+    // Clock stretching holds the bus until the conversion is finished
+    if ( iMeasuring && iClkStretch && ( NativeClock::NowUs() < iReadyAtUs ) )
+    {
+        iStats.iStretches++;
+        NativeClock::Advance( iReadyAtUs - NativeClock::NowUs() );
+    }
+
+    UpdatePeriodic();
+
+    const bool readable = iFrameValid && ( ( iPeriodUs == 0 ) || iFetchPending );
+
+    if ( !readable )
+    {
+        iStats.iNacks++;
+        Record( 'N', nullptr, 0 );
+        return 0;
+    }
+
+    memcpy( aData, iFrame, size );
+    iFrameValid = false;
+    iFetchPending = false;
+    iStats.iFrames++;
+    Record( 'R', aData, size );
+
+    return size;
+}
+
+void Sht3xDeviceModel::Record( const char aKind, const uint8_t *aData, const size_t aSize )
+{
+    if ( !iRecording )
+    {
+        return;
+    }
+
+    char hex[3];
+
+    iRecord += aKind;
+
+    if ( aSize > 0 )
+    {
+        iRecord += ' ';
+    }
+
+    for ( size_t byte = 0; byte < aSize; ++byte )
+    {
+        snprintf( hex, sizeof hex, "%02X", aData[byte] );
+        iRecord += hex;
+    }
+
+    iRecord += '\n';
+}
+
+bool Sht3xDeviceModel::LoadTrace( const char *aText )
+{
+    std::vector<TraceEntry> trace;
+    const char *pos = aText;
+
+    while ( *pos != '\0' )
+    {
+        const char *line_end = strchr( pos, '\n' );
+        const char *end = ( line_end != nullptr ) ? line_end : pos + strlen( pos );
+
+        while ( ( pos < end ) && isspace( (unsigned char) *pos ) )
+        {
+            pos++;
+        }
+
+        if ( ( pos < end ) && ( *pos != '#' ) )
+        {
+            TraceEntry entry = {};
+            const char kind = toupper( (unsigned char) *pos++ );
+
+            switch ( kind )
+            {
+            case 'W': entry.iKind = eTraceWrite; break;
+            case 'R': entry.iKind = eTraceRead;  break;
+            case 'N': entry.iKind = eTraceNack;  break;
+            default:
+                return false;
+            }
+
+            // Parse hex payload, whitespace between bytes is allowed
+            uint8_t nibbles = 0;
+
+            for ( ; pos < end; ++pos )
+            {
+                if ( isspace( (unsigned char) *pos ) )
+                {
+                    continue;
+                }
+
+                if ( !isxdigit( (unsigned char) *pos ) || ( entry.iSize >= SHT3X_FRAME_SIZE ) )
+                {
+                    return false;
+                }
+
+                const char c = tolower( (unsigned char) *pos );
+                const uint8_t value = ( c <= '9' ) ? c - '0' : c - 'a' + 10;
+
+                entry.iData[entry.iSize] = ( entry.iData[entry.iSize] << 4 ) | value;
+
+                if ( ++nibbles == 2 )
+                {
+                    nibbles = 0;
+                    entry.iSize++;
+                }
+            }
+
+            if ( ( nibbles != 0 ) || ( ( kind != 'N' ) && ( entry.iSize == 0 ) ) )
+            {
+                return false;
+            }
+
+            trace.push_back( entry );
+        }
+
+        pos = ( line_end != nullptr ) ? line_end + 1 : end;
+    }
+
+    iTrace = trace;
+    iTracePos = 0;
+
+    return true;
+}
@@ -0,0 +1,254 @@
+#ifndef __SHT3X_DEVICE_MODEL_H__
+#define __SHT3X_DEVICE_MODEL_H__
+
+/**
+ * Simulated SHT3x humidity and temperature sensor
+ * See Datasheet SHT3x-DIS
+ *
+ * The model follows timing of the real device on the virtual clock: a read
+ * issued before a conversion finishes is NACKed (or stretched when clock
+ * stretching was requested), frames carry CRC-8 checksums and periodic mode
+ * produces a new result every period. Faults can be injected and recorded bus
+ * traces can be replayed.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "Wire.h"
+
+/**
+ * Maximal measurement durations in microseconds, see Table 4 of the datasheet
+ */
+#define SHT3X_MEAS_LOW_REP_US       4500
+#define SHT3X_MEAS_MEDIUM_REP_US    6500
+#define SHT3X_MEAS_HIGH_REP_US      15500
+
+/**
+ * Time needed by the device to get ready after soft reset in microseconds
+ */
+#define SHT3X_SOFT_RESET_US         1500
+
+/**
+ * Size of a measurement frame in bytes
+ */
+#define SHT3X_FRAME_SIZE            6
+
+class Sht3xDeviceModel : public I2cDevice
+{
+    public:
+        /**
+         * Enum representing measurement repeatability of the device
+        */
+        enum Repeatability : uint8_t
+        {
+            eLow,
+            eMedium,
+            eHigh
+        };
+
+        /**
+         * Statistics of the device model
+        */
+        struct Stats
+        {
+            uint32_t iCommands;
+            uint32_t iUnknownCommands;
+            uint32_t iFrames;
+            uint32_t iNacks;
+            uint32_t iStretches;
+            uint32_t iTraceMismatches;
+        };
+
+    private:
+        /**
+         * Enum representing type of an entry in a bus trace
+        */
+        enum TraceKind : uint8_t
+        {
+            eTraceWrite,
+            eTraceRead,
+            eTraceNack
+        };
+
+        /**
+         * Entry of a recorded bus trace
+        */
+        struct TraceEntry
+        {
+            TraceKind iKind;
+            uint8_t iData[SHT3X_FRAME_SIZE];
+            uint8_t iSize;
+        };
+
+        /**
+         * Raw temperature and humidity the device measures
+        */
+        uint16_t iRawTemp;
+        uint16_t iRawHum;
+
+        /**
+         * Latched measurement waiting to be read out
+        */
+        uint8_t iFrame[SHT3X_FRAME_SIZE];
+        bool iFrameValid;
+
+        /**
+         * Conversion in progress and virtual time it finishes at
+        */
+        bool iMeasuring;
+        uint64_t iReadyAtUs;
+
+        /**
+         * Clock stretching requested by the last single shot command
+        */
+        bool iClkStretch;
+
+        /**
+         * Periodic acquisition state, period is zero when device is idle
+        */
+        uint64_t iPeriodUs;
+        uint64_t iNextPeriodicUs;
+        Repeatability iPeriodicRep;
+
+        /**
+         * Set when fetch data command was received in periodic mode
+        */
+        bool iFetchPending;
+
+        /**
+         * Device is busy until the time after a soft reset
+        */
+        uint64_t iBusyUntilUs;
+
+        /**
+         * Injected faults
+        */
+        uint32_t iExtraDelayUs;
+        uint32_t iNacksToInject;
+        uint32_t iCrcErrorsToInject;
+
+        /**
+         * Replayed trace and position in it
+        */
+        std::vector<TraceEntry> iTrace;
+        size_t iTracePos;
+
+        /**
+         * Recorded trace, empty when recording is disabled
+        */
+        bool iRecording;
+        std::string iRecord;
+
+        Stats iStats;
+
+        void StartMeasurement( const Repeatability aRep, const bool aClkStretch );
+
+        void LatchFrame();
+
+        void UpdatePeriodic();
+
+        bool ExecuteCommand( const uint16_t aCmd );
+
+        void Record( const char aKind, const uint8_t *aData, const size_t aSize );
+
+        static uint64_t MeasurementTimeUs( const Repeatability aRep );
+
+    public:
+        Sht3xDeviceModel();
+
+        /**
+         * Attaches the device to a simulated bus
+         *
+         * @param aBus bus number
+         * @param aAddr I2C address of the device (0x44 or 0x45)
+        */
+        void Attach( const uint8_t aBus, const uint8_t aAddr )
+        {
+            NativeI2cBus::Attach( aBus, aAddr, this );
+        }
+
+        /**
+         * Sets physical quantities measured by the device
+         *
+         * @param aTemp temperature in Celsius
+         * @param aHum relative humidity in %
+        */
+        void SetTemperature( const float aTemp );
+        void SetHumidity( const float aHum );
+
+        /**
+         * Adds extra time to every conversion
+         *
+         * @param aUs extra delay in microseconds
+        */
+        void InjectDelay( const uint32_t aUs )
+        {
+            iExtraDelayUs = aUs;
+        }
+
+        /**
+         * NACKs next transactions regardless of device state
+         *
+         * @param aCount number of transactions to NACK
+        */
+        void InjectNacks( const uint32_t aCount )
+        {
+            iNacksToInject = aCount;
+        }
+
+        /**
+         * Corrupts CRC of next frames
+         *
+         * @param aCount number of frames to corrupt
+        */
+        void InjectCrcErrors( const uint32_t aCount )
+        {
+            iCrcErrorsToInject = aCount;
+        }
+
+        /**
+         * Loads a bus trace to be replayed
+         *
+         * One transaction per line: "W <hex>" expected command, "R <hex>" frame
+         * returned by the next read, "N" NACK of the next read. Empty lines and
+         * lines starting with '#' are ignored. Once the trace is exhausted the
+         * model answers on its own again.
+         *
+         * @param aText trace text
+         * @return True if trace was parsed successfully
+        */
+        bool LoadTrace( const char *aText );
+
+        /**
+         * Starts or stops recording of bus transactions in trace format
+        */
+        void SetRecording( const bool aEnabled )
+        {
+            iRecording = aEnabled;
+            iRecord.clear();
+        }
+
+        const std::string& GetRecord() const
+        {
+            return iRecord;
+        }
+
+        const Stats& GetStats() const
+        {
+            return iStats;
+        }
+
+        /**
+         * Computes CRC-8 of the device, polynomial 0x31, init 0xFF
+        */
+        static uint8_t Crc( const uint8_t *aData, const size_t aSize );
+
+        bool OnWrite( const uint8_t *aData, const size_t aSize ) override;
+
+        size_t OnRead( uint8_t *aData, const size_t aSize ) override;
+};
+
+#endif /* __SHT3X_DEVICE_MODEL_H__ */
@@ -0,0 +1,86 @@
+#include "Wire.h"
+
+/**
+ * Bits on the bus per transferred byte (8 data bits and ACK)
+ */
+#define I2C_BITS_PER_BYTE       9
+
+/**
+ * Bits spent on START and STOP conditions
+ */
+#define I2C_START_STOP_BITS     2
+
+I2cDevice *NativeI2cBus::iDevices[NATIVE_I2C_NUM_OF_BUSES][NATIVE_I2C_NUM_OF_ADDR];
+I2cBusStats NativeI2cBus::iStats[NATIVE_I2C_NUM_OF_BUSES];
+
+TwoWire Wire = TwoWire( 0 );
+TwoWire Wire1 = TwoWire( 1 );
+
+void TwoWire::ChargeBusTime( const size_t aBytes )
+{
+    const uint64_t bits = aBytes * I2C_BITS_PER_BYTE + I2C_START_STOP_BITS;
+    const uint64_t duration_us = ( bits * 1000000 + iFrequency - 1 ) / iFrequency;
+
+    NativeClock::Advance( duration_us );
+    NativeI2cBus::Stats( iBusNum ).iBusyUs += duration_us;
+}
+
+size_t TwoWire::write( const uint8_t *aData, const size_t aSize )
+{
+    size_t count = 0;
+
+    while ( ( count < aSize ) && ( iTxLen < NATIVE_I2C_BUFFER_SIZE ) )
+    {
+        iTxBuff[iTxLen++] = aData[count++];
+    }
+
+    return count;
+}
+
+uint8_t TwoWire::endTransmission( const bool )
+{
+    I2cDevice *device = NativeI2cBus::Find( iBusNum, iTxAddr );
+    I2cBusStats &stats = NativeI2cBus::Stats( iBusNum );
+
+    stats.iWrites++;
+
+    // Address byte is always clocked out, data only when address was acknowledged
+    if ( ( device == nullptr ) || !device->OnWrite( iTxBuff, iTxLen ) )
+    {
+        ChargeBusTime( 1 );
+        stats.iNacks++;
+        iTxLen = 0;
+
+        // Same code as the ESP32 core uses for address NACK
+        return 2;
+    }
+
+    ChargeBusTime( 1 + iTxLen );
+    iTxLen = 0;
+
+    return 0;
+}
+
+uint8_t TwoWire::requestFrom( const uint16_t aAddr, const uint8_t aSize, const bool )
+{
+    I2cDevice *device = NativeI2cBus::Find( iBusNum, aAddr );
+    I2cBusStats &stats = NativeI2cBus::Stats( iBusNum );
+    const size_t size = ( aSize < NATIVE_I2C_BUFFER_SIZE ) ? aSize : NATIVE_I2C_BUFFER_SIZE;
+
+    stats.iReads++;
+
+    iRxIdx = 0;
+    iRxLen = ( device != nullptr ) ? device->OnRead( iRxBuff, size ) : 0;
+
+    if ( iRxLen == 0 )
+    {
+        stats.iNacks++;
+        ChargeBusTime( 1 );
+    }
+    else
+    {
+        ChargeBusTime( 1 + iRxLen );
+    }
+
+    return (uint8_t) iRxLen;
+}
@@ -0,0 +1,231 @@
+#ifndef __NATIVE_WIRE_H__
+#define __NATIVE_WIRE_H__
+
+/**
+ * Host (native) replacement of the ESP32 Wire library. Transactions are routed
+ * to simulated devices attached to a bus number and cost virtual time that
+ * matches the configured bus clock.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "Arduino.h"
+
+/**
+ * Number of simulated I2C buses (ESP32 has two hardware controllers)
+ */
+#define NATIVE_I2C_NUM_OF_BUSES     2
+
+/**
+ * Number of 7 bit I2C addresses
+ */
+#define NATIVE_I2C_NUM_OF_ADDR      128
+
+/**
+ * Size of transmit and receive buffers in bytes, same as the ESP32 core
+ */
+#define NATIVE_I2C_BUFFER_SIZE      128
+
+/**
+ * Default frequency of simulated I2C bus in Hz
+ */
+#define NATIVE_I2C_DEFAULT_FREQ_HZ  100000
+
+/**
+ * Interface of a simulated I2C slave device
+ */
+class I2cDevice
+{
+    public:
+        virtual ~I2cDevice()
+        {
+        }
+
+        /**
+         * Called when master writes data to the device
+         *
+         * @param aData written bytes
+         * @param aSize number of written bytes
+         * @return True if device acknowledged the transaction
+        */
+        virtual bool OnWrite( const uint8_t *aData, const size_t aSize ) = 0;
+
+        /**
+         * Called when master reads data from the device
+         *
+         * @param aData buffer to be filled by device
+         * @param aSize number of requested bytes
+         * @return Number of bytes sent by device, zero on NACK
+        */
+        virtual size_t OnRead( uint8_t *aData, const size_t aSize ) = 0;
+};
+
+/**
+ * Statistics of a simulated I2C bus
+ */
+struct I2cBusStats
+{
+    uint32_t iWrites;
+    uint32_t iReads;
+    uint32_t iNacks;
+    uint64_t iBusyUs;
+};
+
+class NativeI2cBus
+{
+    /**
+     * Devices attached to buses, indexed by bus number and address
+    */
+    static I2cDevice *iDevices[NATIVE_I2C_NUM_OF_BUSES][NATIVE_I2C_NUM_OF_ADDR];
+
+    /**
+     * Statistics of buses
+    */
+    static I2cBusStats iStats[NATIVE_I2C_NUM_OF_BUSES];
+
+    public:
+        static void Attach( const uint8_t aBus, const uint8_t aAddr, I2cDevice *aDevice )
+        {
+            iDevices[aBus][aAddr & 0x7F] = aDevice;
+        }
+
+        static void Detach( const uint8_t aBus, const uint8_t aAddr )
+        {
+            Attach( aBus, aAddr, nullptr );
+        }
+
+        static I2cDevice* Find( const uint8_t aBus, const uint16_t aAddr )
+        {
+            return ( aBus < NATIVE_I2C_NUM_OF_BUSES ) ? iDevices[aBus][aAddr & 0x7F] : nullptr;
+        }
+
+        static I2cBusStats& Stats( const uint8_t aBus )
+        {
+            return iStats[aBus];
+        }
+
+        static void ResetStats()
+        {
+            memset( iStats, 0, sizeof iStats );
+        }
+};
+
+class TwoWire
+{
+    /**
+     * Number of simulated bus this interface drives
+    */
+    uint8_t iBusNum;
+
+    /**
+     * Bus clock frequency in Hz
+    */
+    uint32_t iFrequency;
+
+    /**
+     * Address of a device targeted by pending transmission
+    */
+    uint16_t iTxAddr;
+
+    /**
+     * Pending transmission data
+    */
+    uint8_t iTxBuff[NATIVE_I2C_BUFFER_SIZE];
+    size_t iTxLen;
+
+    /**
+     * Received data
+    */
+    uint8_t iRxBuff[NATIVE_I2C_BUFFER_SIZE];
+    size_t iRxLen;
+    size_t iRxIdx;
+
+    /**
+     * Advances virtual time by duration of a transaction
+     *
+     * @param aBytes number of bytes on the bus including the address byte
+    */
+    void ChargeBusTime( const size_t aBytes );
+
+    public:
+        TwoWire( const uint8_t aBusNum ):
+            iBusNum( aBusNum ),
+            iFrequency( NATIVE_I2C_DEFAULT_FREQ_HZ ),
+            iTxAddr( 0 ),
+            iTxLen( 0 ),
+            iRxLen( 0 ),
+            iRxIdx( 0 )
+        {
+        }
+
+        bool begin( int = -1, int = -1, uint32_t aFrequency = 0 )
+        {
+            if ( aFrequency != 0 )
+            {
+                iFrequency = aFrequency;
+            }
+
+            return true;
+        }
+
+        bool setClock( const uint32_t aFrequency )
+        {
+            iFrequency = aFrequency;
+            return true;
+        }
+
+        uint32_t getClock() const
+        {
+            return iFrequency;
+        }
+
+        uint8_t getBusNum() const
+        {
+            return iBusNum;
+        }
+
+        void beginTransmission( const uint16_t aAddr )
+        {
+            iTxAddr = aAddr;
+            iTxLen = 0;
+        }
+
+        uint8_t endTransmission( const bool aSendStop = true );
+
+        uint8_t requestFrom( const uint16_t aAddr, const uint8_t aSize, const bool aSendStop = true );
+
+        size_t write( const uint8_t aData )
+        {
+            return write( &aData, 1 );
+        }
+
+        size_t write( const uint8_t *aData, const size_t aSize );
+
+        int available()
+        {
+            return (int)( iRxLen - iRxIdx );
+        }
+
+        int read()
+        {
+            return ( iRxIdx < iRxLen ) ? iRxBuff[iRxIdx++] : -1;
+        }
+
+        int peek()
+        {
+            return ( iRxIdx < iRxLen ) ? iRxBuff[iRxIdx] : -1;
+        }
+
+        void flush()
+        {
+            iTxLen = 0;
+            iRxLen = 0;
+            iRxIdx = 0;
+        }
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
+
+#endif /* __NATIVE_WIRE_H__ */
@@ -0,0 +1,144 @@
+#ifndef __BENCHMARK_H__
+#define __BENCHMARK_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "Arduino.h"
+
+/**
+ * Measures host wall time and virtual time of a single call
+ */
+class Stopwatch
+{
+    std::chrono::steady_clock::time_point iHostStart;
+    uint64_t iVirtualStart;
+
+    public:
+        Stopwatch(): iVirtualStart( 0 )
+        {
+        }
+
+        void Start()
+        {
+            iVirtualStart = NativeClock::NowUs();
+            iHostStart = std::chrono::steady_clock::now();
+        }
+
+        uint64_t HostNs() const
+        {
+            const auto now = std::chrono::steady_clock::now();
+
+            return std::chrono::duration_cast<std::chrono::nanoseconds>( now - iHostStart ).count();
+        }
+
+        uint64_t VirtualUs() const
+        {
+            return NativeClock::NowUs() - iVirtualStart;
+        }
+};
+
+/**
+ * Collects per-call latency of a benchmarked operation
+ *
+ * Two clocks are sampled for every call: host wall time, which tracks CPU cost
+ * of the code itself, and virtual time, which tracks time the firmware would
+ * spend on the bus or waiting for the sensor on the target.
+ */
+class LatencyStats
+{
+    const char *iName;
+
+    std::vector<uint64_t> iHostNs;
+    std::vector<uint64_t> iVirtualUs;
+
+    Stopwatch iWatch;
+
+    static uint64_t Percentile( std::vector<uint64_t> &aSamples, const uint32_t aPercent )
+    {
+        if ( aSamples.empty() )
+        {
+            return 0;
+        }
+
+        std::sort( aSamples.begin(), aSamples.end() );
+
+        return aSamples[( aSamples.size() - 1 ) * aPercent / 100];
+    }
+
+    static double Mean( const std::vector<uint64_t> &aSamples )
+    {
+        double sum = 0;
+
+        for ( const uint64_t sample : aSamples )
+        {
+            sum += sample;
+        }
+
+        return aSamples.empty() ? 0 : sum / aSamples.size();
+    }
+
+    public:
+        LatencyStats( const char *aName ): iName( aName )
+        {
+        }
+
+        /**
+         * Marks beginning of a measured call
+        */
+        void Start()
+        {
+            iWatch.Start();
+        }
+
+        /**
+         * Marks end of a measured call and stores its latency
+        */
+        void Stop()
+        {
+            Add( iWatch.HostNs(), iWatch.VirtualUs() );
+        }
+
+        /**
+         * Stores latency of a call measured elsewhere
+         *
+         * @param aHostNs host wall time in nanoseconds
+         * @param aVirtualUs virtual time in microseconds
+        */
+        void Add( const uint64_t aHostNs, const uint64_t aVirtualUs )
+        {
+            iHostNs.push_back( aHostNs );
+            iVirtualUs.push_back( aVirtualUs );
+        }
+
+        size_t GetCount() const
+        {
+            return iHostNs.size();
+        }
+
+        static void PrintHeader()
+        {
+            printf( "%-28s %8s %10s %10s %10s %10s %12s %12s\n",
+                    "benchmark", "calls", "mean ns", "p50 ns", "p99 ns", "max ns", "mean sim us", "max sim us" );
+        }
+
+        void Print()
+        {
+            const double host_mean = Mean( iHostNs );
+            const double virt_mean = Mean( iVirtualUs );
+
+            printf( "%-28s %8zu %10.0f %10llu %10llu %10llu %12.1f %12llu\n",
+                    iName,
+                    iHostNs.size(),
+                    host_mean,
+                    (unsigned long long) Percentile( iHostNs, 50 ),
+                    (unsigned long long) Percentile( iHostNs, 99 ),
+                    (unsigned long long) Percentile( iHostNs, 100 ),
+                    virt_mean,
+                    (unsigned long long) Percentile( iVirtualUs, 100 ) );
+        }
+};
+
+#endif /* __BENCHMARK_H__ */
@@ -0,0 +1,1468 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <Arduino.h>
+#include <Wire.h>
+#include <ArduinoJson.h>
+#include "MotionSensor.h"
+#include "ShtSensor.h"
+#include "I2cBusManager.h"
+#include "Crc8.h"
+#include "TelemetryCodec.h"
+#include "SampleBatch.h"
+#include "ChangeDetector.h"
+#include "ReadingFilter.h"
+#include "AcquisitionScheduler.h"
+#include "CoopScheduler.h"
+#include "RtcSampleLog.h"
+#include "TelemetrySpool.h"
+#include "HeatshrinkDecoder.h"
+#include "HeatshrinkEncoder.h"
+#include <SPIFFS.h>
+#include "Sht3xDeviceModel.h"
+#include "Benchmark.h"
+#include <thread>
+
+/**
+ * Number of simulated loop() passes per benchmark
+ */
+#define BENCH_LOOP_ITERATIONS   200000
+
+/**
+ * Virtual time between two loop() passes in microseconds
+ */
+#define BENCH_LOOP_PERIOD_US    1000
+
+/**
+ * Publish period of the telemetry in main.cpp in milliseconds
+ */
+#define BENCH_PUBLISH_PERIOD_MS 2000
+
+/**
+ * Size of the image compressed by the heatshrink check
+ */
+#define HEATSHRINK_IMAGE_SIZE   ( 128 * 1024 )
+
+/**
+ * Size of the output buffer of the decoder, same as in the OTA writer task
+ */
+#define HEATSHRINK_OUT_SIZE     512
+
+/**
+ * Number of events passed between threads by the queue stress test
+ */
+#define SPSC_STRESS_EVENTS      1000000
+
+/**
+ * Capacity of the queue in the stress test, small to provoke full queue
+ */
+#define SPSC_STRESS_QUEUE_SIZE  16
+
+/**
+ * Recorded trace of two measurement cycles with one late response
+ */
+static const char *kRecordedTrace =
+    "# two single shot cycles, second one answered on the retry\n"
+    "W 2400\n"
+    "R 66 A3 21 73 33 01\n"
+    "W 2400\n"
+    "N\n"
+    "R 66 B0 31 73 00 97\n";
+
+static Sht3xDeviceModel Sht3x;
+
+static I2cBusManager Buses;
+
+static uint32_t Failures = 0;
+
+static void Check( const bool aCondition, const char *aWhat )
+{
+    if ( !aCondition )
+    {
+        printf( "FAILED: %s\n", aWhat );
+        Failures++;
+    }
+}
+
+/**
+ * Builds and serializes the telemetry document the same way loop() does
+ */
+static size_t BuildJson( ShtSensor &aSensor, MotionSensor &aMotion, char *aMsg, const size_t aSize )
+{
+    StaticJsonDocument<200> doc;
+    char temp[12];
+    char hum[12];
+
+    TelemetryCodec::FormatCenti( aSensor.GetTemperatureCenti(), temp, sizeof temp );
+    TelemetryCodec::FormatCenti( aSensor.GetHumidityCenti(), hum, sizeof hum );
+
+    doc["temp"] = serialized( temp );
+    doc["hum"] = serialized( hum );
+    doc["movmnt"] = aMotion.IsMovement();
+    doc["signl"] = -60;
+    doc["version"] = "0.4";
+
+    return serializeJson( doc, aMsg, aSize );
+}
+
+/**
+ * Benchmarks ShtSensor::Update() split by the phase the call ended up in
+ */
+static void BenchUpdate( ShtSensor &aSensor )
+{
+    LatencyStats tx( "ShtSensor::Update tx" );
+    LatencyStats rx( "ShtSensor::Update rx" );
+    LatencyStats idle( "ShtSensor::Update idle" );
+
+    for ( uint32_t i = 0; i < BENCH_LOOP_ITERATIONS; ++i )
+    {
+        NativeClock::Advance( BENCH_LOOP_PERIOD_US );
+
+        const I2cBusStats before = NativeI2cBus::Stats( 0 );
+        Stopwatch watch;
+
+        watch.Start();
+        aSensor.Update();
+
+        const uint64_t host_ns = watch.HostNs();
+        const uint64_t virtual_us = watch.VirtualUs();
+        const I2cBusStats &after = NativeI2cBus::Stats( 0 );
+
+        // Classify the call by the bus traffic it generated
+        LatencyStats &target = ( after.iReads != before.iReads ) ? rx :
+                               ( after.iWrites != before.iWrites ) ? tx : idle;
+
+        target.Add( host_ns, virtual_us );
+    }
+
+    tx.Print();
+    rx.Print();
+    idle.Print();
+
+    Check( fabs( aSensor.GetTemperature() - 23.0f ) < 0.01f, "temperature matches device model" );
+    Check( fabs( aSensor.GetHumidity() - 45.0f ) < 0.01f, "humidity matches device model" );
+}
+
+/**
+ * Benchmarks one pass of the main loop: sensor update, LED mirror and the
+ * periodic JSON build
+ */
+static void BenchLoop( ShtSensor &aSensor, MotionSensor &aMotion )
+{
+    LatencyStats loop_stats( "loop() iteration" );
+    LatencyStats json_stats( "loop() JSON build" );
+    char msg[256];
+    uint64_t timestamp = 0;
+
+    for ( uint32_t i = 0; i < BENCH_LOOP_ITERATIONS; ++i )
+    {
+        NativeClock::Advance( BENCH_LOOP_PERIOD_US );
+        NativeGpio::Drive( MOTION_SENSOR_PIN, ( i / 5000 ) & 1 );
+
+        loop_stats.Start();
+
+        aSensor.Update();
+        digitalWrite( BUILTIN_LED, !aMotion.IsMovement() );
+
+        const uint64_t now = millis();
+
+        if ( now - timestamp >= BENCH_PUBLISH_PERIOD_MS )
+        {
+            timestamp = now;
+
+            json_stats.Start();
+            BuildJson( aSensor, aMotion, msg, sizeof msg );
+            json_stats.Stop();
+        }
+
+        loop_stats.Stop();
+    }
+
+    loop_stats.Print();
+    json_stats.Print();
+}
+
+/**
+ * Checks binary telemetry survives encode/decode and compares it with JSON
+ */
+static void BenchTelemetryCodec( ShtSensor &aSensor, MotionSensor &aMotion )
+{
+    LatencyStats encode_stats( "TelemetryCodec::Encode" );
+    LatencyStats json_stats( "JSON serialize" );
+    uint8_t frame[TELEMETRY_FRAME_SIZE];
+    char msg[256];
+    size_t json_size = 0;
+
+    // Extremes of every field must round trip exactly
+    const TelemetryRecord edge_cases[] =
+    {
+        { -4500, 0,     true,  true,  false, -128, 0,   0,   0 },
+        { 13000, 10000, true,  true,  true,  0,    255, 255, UINT32_MAX },
+        { INT16_MIN, UINT16_MAX, false, false, true, 127, 1, 2, 0x12345678 }
+    };
+
+    for ( const TelemetryRecord &record : edge_cases )
+    {
+        TelemetryRecord decoded = {};
+
+        Check( TelemetryCodec::Encode( record, frame, sizeof frame ) == TELEMETRY_FRAME_SIZE, "frame is encoded" );
+        Check( TelemetryCodec::Decode( frame, sizeof frame, decoded ), "frame is decoded" );
+        Check( ( decoded.iTempCenti == record.iTempCenti ) && ( decoded.iHumCenti == record.iHumCenti ) &&
+               ( decoded.iTempValid == record.iTempValid ) && ( decoded.iHumValid == record.iHumValid ) &&
+               ( decoded.iMovement == record.iMovement ) && ( decoded.iRssi == record.iRssi ) &&
+               ( decoded.iVersionMajor == record.iVersionMajor ) && ( decoded.iVersionMinor == record.iVersionMinor ) &&
+               ( decoded.iOfflineMs == record.iOfflineMs ), "decoded record equals encoded one" );
+    }
+
+    frame[0] = TELEMETRY_SCHEMA_VERSION + 1;
+    TelemetryRecord rejected = {};
+    Check( !TelemetryCodec::Decode( frame, sizeof frame, rejected ), "unknown schema version is rejected" );
+
+    Check( TelemetryCodec::TempToCenti( 23.456f ) == 2346, "temperature rounds to nearest hundredth" );
+    Check( TelemetryCodec::TempToCenti( -0.004f ) == 0, "small negative temperature rounds to zero" );
+    Check( TelemetryCodec::HumToCenti( 45.004f ) == 4500, "humidity rounds to nearest hundredth" );
+
+    for ( uint32_t i = 0; i < 10000; ++i )
+    {
+        TelemetryRecord record = {};
+
+        encode_stats.Start();
+        record.iTempCenti = aSensor.GetTemperatureCenti();
+        record.iHumCenti = aSensor.GetHumidityCenti();
+        record.iMovement = aMotion.IsMovement();
+        TelemetryCodec::Encode( record, frame, sizeof frame );
+        encode_stats.Stop();
+
+        json_stats.Start();
+        json_size = BuildJson( aSensor, aMotion, msg, sizeof msg );
+        json_stats.Stop();
+    }
+
+    encode_stats.Print();
+    json_stats.Print();
+
+    printf( "payload: binary %u bytes, JSON %u bytes\n", TELEMETRY_FRAME_SIZE, (unsigned) json_size );
+}
+
+/**
+ * Checks flush limits of the sample batch and the batch frame round trip
+ */
+static void CheckSampleBatch()
+{
+    SampleBatch batch( { 10, 60000, 1024 }, TELEMETRY_BATCH_HEADER_SIZE, TELEMETRY_BATCH_SAMPLE_SIZE );
+    TelemetrySample samples[SAMPLE_BATCH_CAPACITY];
+    TelemetrySample decoded[SAMPLE_BATCH_CAPACITY];
+    uint8_t frame[TELEMETRY_BATCH_HEADER_SIZE + SAMPLE_BATCH_CAPACITY * TELEMETRY_BATCH_SAMPLE_SIZE];
+
+    for ( uint8_t idx = 0; idx < 9; ++idx )
+    {
+        batch.Push( { 1000u + idx * 2000u, (int16_t)( 2300 + idx ), 4500, true, true, ( idx & 1 ) != 0, -60 } );
+    }
+
+    Check( !batch.IsFlushDue( 17000 ), "batch below limits is not flushed" );
+    Check( batch.IsFlushDue( 61000 ), "batch is flushed by age" );
+
+    batch.Push( { 19000, 2309, 4500, true, true, false, -60 } );
+    Check( batch.IsFlushDue( 19000 ), "batch is flushed by count" );
+
+    batch.SetConfig( { 32, 60000, TELEMETRY_BATCH_HEADER_SIZE + 10 * TELEMETRY_BATCH_SAMPLE_SIZE } );
+    Check( batch.IsFlushDue( 19000 ), "batch is flushed by byte budget" );
+
+    // A failed publish keeps the batch for the next flush
+    Check( ( batch.Peek( samples, SAMPLE_BATCH_CAPACITY ) == 10 ) && ( batch.GetCount() == 10 ), "peek keeps the batch" );
+
+    const uint8_t count = batch.Drain( samples, SAMPLE_BATCH_CAPACITY );
+    const size_t size = TelemetryCodec::EncodeBatch( samples, count, 0, 4, frame, sizeof frame );
+
+    Check( ( count == 10 ) && ( batch.GetCount() == 0 ), "drain empties the batch" );
+    Check( TelemetryCodec::DecodeBatch( frame, size, decoded, SAMPLE_BATCH_CAPACITY ) == count, "batch frame is decoded" );
+
+    for ( uint8_t idx = 0; idx < count; ++idx )
+    {
+        Check( ( decoded[idx].iTimestamp == samples[idx].iTimestamp ) &&
+               ( decoded[idx].iTempCenti == samples[idx].iTempCenti ) &&
+               ( decoded[idx].iMovement == samples[idx].iMovement ), "decoded sample equals encoded one" );
+    }
+
+    for ( uint8_t idx = 0; idx < SAMPLE_BATCH_CAPACITY + 8; ++idx )
+    {
+        batch.Push( { idx, 0, 0, true, true, false, 0 } );
+    }
+
+    Check( batch.GetDropped() == 8, "full batch overwrites the oldest samples" );
+    Check( ( batch.Drain( samples, 1 ) == 1 ) && ( samples[0].iTimestamp == 8 ), "oldest surviving sample comes first" );
+
+    // Deltas of a batch frame are 16 bits, a gap above 65.5 s saturates
+    const TelemetrySample gap[3] = { { 1000, 2300, 4500, true, true, false, -60 },
+                                     { 1000 + UINT16_MAX, 2300, 4500, true, true, false, -60 },
+                                     { 1000 + UINT16_MAX + 70000, 2300, 4500, true, true, false, -60 } };
+    const size_t gap_size = TelemetryCodec::EncodeBatch( gap, 3, 0, 4, frame, sizeof frame );
+
+    Check( ( TelemetryCodec::DecodeBatch( frame, gap_size, decoded, SAMPLE_BATCH_CAPACITY ) == 3 ) &&
+           ( decoded[1].iTimestamp == gap[1].iTimestamp ) && ( decoded[2].iTimestamp == gap[1].iTimestamp + UINT16_MAX ),
+           "gap of 65.5 s is exact, longer one saturates" );
+
+    // The age limit of a binary batch is clamped to UINT16_MAX, a later sample flushes the batch before it is added
+    batch.Drain( samples, SAMPLE_BATCH_CAPACITY );
+    batch.SetConfig( { 32, UINT16_MAX, 1024 } );
+    batch.Push( gap[0] );
+    Check( !batch.IsFlushDue( gap[1].iTimestamp - 1 ) && batch.IsFlushDue( gap[0].iTimestamp + 70000 ),
+           "sample 70 s after the oldest one is not batched with it" );
+}
+
+/**
+ * Checks report-on-change decisions of the change detector
+ */
+static void CheckChangeDetector()
+{
+    ChangeDetector detector( { true, { 10, 0 }, { 100, 50 }, 60000, 500 } );
+
+    Check( detector.Evaluate( { 0, 2300, 4000, true, true, false, -60 } ), "first sample is reported" );
+    Check( !detector.Evaluate( { 1000, 2309, 4099, true, true, false, -60 } ), "change inside deadbands is suppressed" );
+    Check( detector.Evaluate( { 2000, 2310, 4000, true, true, false, -60 } ), "temperature change at absolute deadband is reported" );
+    Check( !detector.Evaluate( { 3000, 2310, 4150, true, true, false, -60 } ), "relative deadband dominates absolute one" );
+    Check( detector.Evaluate( { 4000, 2310, 4200, true, true, false, -60 } ), "humidity change at relative deadband is reported" );
+    Check( !detector.Evaluate( { 4200, 2310, 4200, true, true, true, -60 } ), "reports are rate limited" );
+    Check( detector.Evaluate( { 4600, 2310, 4200, true, true, true, -60 } ), "motion change is reported" );
+    Check( detector.Evaluate( { 4700 + 60000, 2310, 4200, true, true, true, -60 } ), "heartbeat is reported" );
+    Check( ( detector.GetHeartbeatReports() == 1 ) && ( detector.GetSuppressed() == 3 ), "report counters" );
+}
+
+/**
+ * Checks the filter stage removes spikes, follows real steps and keeps window
+ * statistics equal to a stored-window reference, then benchmarks it
+ */
+static void CheckReadingFilter()
+{
+    ReadingFilter filter( { 5, 2, 200, 3 } );
+
+    for ( uint8_t idx = 0; idx < 10; ++idx )
+    {
+        filter.Add( 2300 );
+    }
+
+    Check( filter.Add( 9000 ) && ( filter.GetValue() == 2300 ), "single spike is removed by the median" );
+
+    uint8_t rejected = 0;
+
+    for ( uint8_t idx = 0; idx < 8; ++idx )
+    {
+        rejected += !filter.Add( 2800 );
+    }
+
+    Check( rejected == 3, "step is rejected for the maximal number of outliers" );
+    Check( filter.GetValue() == 2800, "step is followed after the outliers" );
+
+    filter.TakeWindow();
+
+    filter.SetConfig( { 5, 40, 200, 3 } );
+    Check( filter.GetConfig().iEmaShift == FILTER_EMA_FRACTION, "EMA shift is clamped" );
+
+    // Window of a noisy signal against the stored-window double reference
+    int32_t values[1000];
+    double sum = 0;
+    uint32_t seed = 1;
+
+    for ( uint16_t idx = 0; idx < 1000; ++idx )
+    {
+        seed = seed * 1103515245 + 12345;
+        values[idx] = 2800 + (int32_t)( ( seed >> 16 ) % 41 ) - 20;
+    }
+
+    ReadingFilter raw( { 1, 0, 0, 0 } );
+    int32_t min = values[0];
+    int32_t max = values[0];
+
+    for ( uint16_t idx = 0; idx < 1000; ++idx )
+    {
+        raw.Add( values[idx] );
+        sum += values[idx];
+        min = ( values[idx] < min ) ? values[idx] : min;
+        max = ( values[idx] > max ) ? values[idx] : max;
+    }
+
+    const double mean = sum / 1000;
+    double squares = 0;
+
+    for ( uint16_t idx = 0; idx < 1000; ++idx )
+    {
+        squares += ( values[idx] - mean ) * ( values[idx] - mean );
+    }
+
+    const WindowRecord window = raw.TakeWindow();
+
+    Check( ( window.iCount == 1000 ) && ( window.iMin == min ) && ( window.iMax == max ), "window count and extremes" );
+    Check( window.iMean == (int32_t) lround( mean ), "window mean equals reference" );
+    Check( window.iStdDev == (uint32_t) sqrt( squares / 1000 ), "window deviation equals reference" );
+    Check( raw.TakeWindow().iCount == 0, "taking a window starts a new one" );
+
+    LatencyStats add( "filter Add() x16" );
+    volatile int32_t sink = 0;
+
+    for ( uint32_t iter = 0; iter < BENCH_LOOP_ITERATIONS / 10; ++iter )
+    {
+        add.Start();
+        for ( uint8_t idx = 0; idx < 16; ++idx )
+        {
+            filter.Add( values[( iter * 16 + idx ) % 1000] );
+        }
+        add.Stop();
+        sink = sink + filter.GetValue();
+    }
+
+    add.Print();
+}
+
+/**
+ * Checks a CRC-8 variant against the datasheet vector and the device model
+ * and benchmarks fused validation of measurement frames
+ */
+template<typename Crc>
+static void CheckCrcVariant( const char *aName )
+{
+    const uint8_t vector[] = { 0xBE, 0xEF };
+    uint32_t mismatches = 0;
+
+    Check( Crc::Compute( vector, sizeof vector ) == 0x92, "CRC of 0xBEEF is 0x92" );
+
+    for ( uint32_t word = 0; word <= 0xFFFF; ++word )
+    {
+        const uint8_t data[] = { (uint8_t)( word >> 8 ), (uint8_t) word };
+
+        mismatches += Crc::Compute( data, 2 ) != Sht3xDeviceModel::Crc( data, 2 );
+    }
+
+    Check( mismatches == 0, "CRC matches device model for all words" );
+
+    uint8_t frame[SHT3X_FRAME_SIZE] = { 0xBE, 0xEF, 0x92, 0x66, 0xA3, 0x00 };
+    frame[5] = Crc::Compute( &frame[3], 2 );
+
+    Check( Crc::ValidateWords( frame, 2 ) == 0x03, "valid frame passes fused validation" );
+
+    for ( uint8_t byte = 0; byte < SHT3X_FRAME_SIZE; ++byte )
+    {
+        frame[byte] ^= 0x10;
+        Check( Crc::ValidateWords( frame, 2 ) == ( ( byte < 3 ) ? 0x02 : 0x01 ), "corrupted word fails fused validation" );
+        frame[byte] ^= 0x10;
+    }
+
+    char name[48];
+    snprintf( name, sizeof name, "CRC %s, %u B table", aName, (unsigned) Crc::GetTableSize() );
+
+    LatencyStats stats( name );
+    volatile uint8_t sink = 0;
+
+    for ( uint32_t iter = 0; iter < BENCH_LOOP_ITERATIONS / 10; ++iter )
+    {
+        frame[1] = iter;
+
+        // Batches of sixteen frames amortize the stopwatch overhead
+        stats.Start();
+        for ( uint8_t idx = 0; idx < 16; ++idx )
+        {
+            frame[4] = idx;
+            sink = sink + Crc::ValidateWords( frame, 2 );
+        }
+        stats.Stop();
+    }
+
+    stats.Print();
+}
+
+static void BenchCrc()
+{
+    CheckCrcVariant<Crc8Bitwise<SHT_CRC_POLYNOMIAL, SHT_CRC_INIT>>( "bitwise x16" );
+    CheckCrcVariant<Crc8Nibble<SHT_CRC_POLYNOMIAL, SHT_CRC_INIT>>( "nibble x16" );
+    CheckCrcVariant<Crc8Table<SHT_CRC_POLYNOMIAL, SHT_CRC_INIT>>( "table x16" );
+}
+
+/**
+ * Checks fixed-point conversion of every raw value against exact rounding and
+ * against the former double conversion, then benchmarks both
+ */
+static void BenchFixedPoint()
+{
+    uint32_t inexact = 0;
+    double worst = 0;
+
+    for ( uint32_t raw = 0; raw <= 0xFFFF; ++raw )
+    {
+        // Exact rational value rounded half up, in integers only
+        const int32_t temp = (int32_t)( ( 2ULL * 17500 * raw + 65535 ) / ( 2 * 65535 ) ) - 4500;
+        const int32_t hum = (int32_t)( ( 2ULL * 10000 * raw + 65535 ) / ( 2 * 65535 ) );
+
+        inexact += ShtDataResponse::TempCentiFromRaw( raw ) != temp;
+        inexact += ShtDataResponse::HumCentiFromRaw( raw ) != hum;
+
+        const double temp_double = -45 + 175.0 * ( raw / 65535.0 );
+        const double hum_double = 100.0 * ( raw / 65535.0 );
+
+        worst = fmax( worst, fabs( ShtDataResponse::TempCentiFromRaw( raw ) / 100.0 - temp_double ) );
+        worst = fmax( worst, fabs( ShtDataResponse::HumCentiFromRaw( raw ) / 100.0 - hum_double ) );
+    }
+
+    Check( inexact == 0, "fixed point equals exactly rounded value for every raw value" );
+    Check( worst <= 0.005 + 1e-9, "fixed point is within 0.005 of double conversion" );
+
+    char text[12];
+
+    Check( TelemetryCodec::FormatCenti( -4500, text, sizeof text ) && !strcmp( text, "-45.00" ), "negative value formats" );
+    Check( TelemetryCodec::FormatCenti( -5, text, sizeof text ) && !strcmp( text, "-0.05" ), "small negative value formats" );
+    Check( TelemetryCodec::FormatCenti( 2346, text, sizeof text ) && !strcmp( text, "23.46" ), "positive value formats" );
+    Check( !TelemetryCodec::FormatCenti( 2346, text, 4 ), "short buffer is refused" );
+
+    LatencyStats fixed( "raw->centi fixed x16" );
+    LatencyStats soft( "raw->float double x16" );
+    volatile int32_t fixed_sink = 0;
+    volatile float float_sink = 0;
+
+    for ( uint32_t iter = 0; iter < BENCH_LOOP_ITERATIONS / 10; ++iter )
+    {
+        const uint16_t base = iter * 16;
+
+        fixed.Start();
+        for ( uint16_t raw = base; raw != (uint16_t)( base + 16 ); ++raw )
+        {
+            fixed_sink = fixed_sink + ShtDataResponse::TempCentiFromRaw( raw ) + ShtDataResponse::HumCentiFromRaw( raw );
+        }
+        fixed.Stop();
+
+        soft.Start();
+        for ( uint16_t raw = base; raw != (uint16_t)( base + 16 ); ++raw )
+        {
+            float_sink = float_sink + (float)( -45 + 175.0 * ( raw / 65535.0 ) ) + (float)( 100.0 * ( raw / 65535.0 ) );
+        }
+        soft.Stop();
+    }
+
+    fixed.Print();
+    soft.Print();
+}
+
+/**
+ * Checks motion edges travel from the ISR to the main loop
+ */
+static void CheckMotionEvents( MotionSensor &aMotion )
+{
+    InterruptEvent event;
+
+    aMotion.EnableInterrupt();
+
+    NativeClock::Advance( 100 );
+    NativeGpio::Drive( MOTION_SENSOR_PIN, HIGH );
+    const uint32_t rise_time = micros();
+    NativeClock::Advance( 100 );
+    NativeGpio::Drive( MOTION_SENSOR_PIN, LOW );
+
+    Check( Interrupt::PollEvent( event ) && ( event.iSource == MOTION_INTERRUPT_NUMBER ) &&
+           event.iData && ( event.iTimestamp == rise_time ), "motion start is taken first" );
+    Check( Interrupt::PollEvent( event ) && !event.iData, "motion end follows" );
+    Check( !Interrupt::PollEvent( event ), "no more motion events" );
+
+    // Edges exceeding the queue while the loop is busy are dropped and counted
+    for ( uint32_t idx = 0; idx < INTERRUPT_EVENT_QUEUE_SIZE; ++idx )
+    {
+        NativeGpio::Drive( MOTION_SENSOR_PIN, HIGH );
+        NativeGpio::Drive( MOTION_SENSOR_PIN, LOW );
+    }
+
+    uint32_t taken = 0;
+    while ( Interrupt::PollEvent( event ) )
+    {
+        taken++;
+    }
+
+    Check( ( taken == INTERRUPT_EVENT_QUEUE_SIZE ) && ( Interrupt::GetEventOverflows() == INTERRUPT_EVENT_QUEUE_SIZE ),
+           "full event queue drops and counts edges" );
+    Check( Interrupt::GetEventHighWater() == INTERRUPT_EVENT_QUEUE_SIZE, "event queue high water reaches capacity" );
+}
+
+/**
+ * Pushes a sequence from one thread and pops it from another, the consumer
+ * checks nothing is lost, duplicated or reordered
+ */
+static void StressSpscQueue()
+{
+    static SpscQueue<InterruptEvent, SPSC_STRESS_QUEUE_SIZE> queue;
+
+    uint32_t retries = 0;
+    uint32_t errors = 0;
+
+    std::thread producer( [&retries]()
+    {
+        for ( uint32_t seq = 0; seq < SPSC_STRESS_EVENTS; ++seq )
+        {
+            const InterruptEvent event = { (uint8_t) seq, seq, ~seq };
+
+            // Unlike an ISR the producer may wait, so every event gets through
+            while ( !queue.Push( event ) )
+            {
+                retries++;
+                std::this_thread::yield();
+            }
+        }
+    } );
+
+    uint32_t expected = 0;
+    Stopwatch watch;
+    watch.Start();
+
+    while ( expected < SPSC_STRESS_EVENTS )
+    {
+        InterruptEvent event;
+
+        if ( !queue.Pop( event ) )
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        if ( ( event.iTimestamp != expected ) || ( event.iData != ~expected ) || ( event.iSource != (uint8_t) expected ) )
+        {
+            errors++;
+        }
+
+        expected++;
+    }
+
+    const uint64_t host_ns = watch.HostNs();
+    producer.join();
+
+    InterruptEvent event;
+    Check( errors == 0, "spsc queue keeps order and content across threads" );
+    Check( !queue.Pop( event ), "spsc queue is empty after stress" );
+    Check( queue.GetOverflows() == retries, "spsc queue counts every rejected push" );
+    Check( queue.GetHighWater() <= SPSC_STRESS_QUEUE_SIZE, "spsc queue never exceeds capacity" );
+
+    printf( "\nspsc stress: %u events, %u full retries, high water %u/%u, %.1f Mevents/s\n",
+            SPSC_STRESS_EVENTS, retries, queue.GetHighWater(), SPSC_STRESS_QUEUE_SIZE,
+            SPSC_STRESS_EVENTS * 1e3 / ( host_ns ? host_ns : 1 ) );
+}
+
+/**
+ * Benchmarks uncontended push and pop of the interrupt event queue
+ */
+static void BenchSpscQueue()
+{
+    static SpscQueue<InterruptEvent, INTERRUPT_EVENT_QUEUE_SIZE> queue;
+    LatencyStats push = LatencyStats( "spsc push+pop x8" );
+
+    for ( uint32_t iter = 0; iter < BENCH_LOOP_ITERATIONS; ++iter )
+    {
+        InterruptEvent event = { MOTION_INTERRUPT_NUMBER, iter, 1 };
+
+        // Batches of eight amortize the stopwatch overhead
+        push.Start();
+        for ( uint8_t idx = 0; idx < 8; ++idx )
+        {
+            queue.Push( event );
+        }
+        for ( uint8_t idx = 0; idx < 8; ++idx )
+        {
+            queue.Pop( event );
+        }
+        push.Stop();
+    }
+
+    push.Print();
+}
+
+/**
+ * Benchmarks Update() while the sensor refuses to answer
+ */
+static void BenchNack( ShtSensor &aSensor )
+{
+    LatencyStats stats( "ShtSensor::Update NACK" );
+
+    for ( uint32_t i = 0; i < 1000; ++i )
+    {
+        NativeClock::Advance( BENCH_LOOP_PERIOD_US );
+        Sht3x.InjectNacks( 100000 );
+
+        stats.Start();
+        aSensor.Update();
+        stats.Stop();
+    }
+
+    Sht3x.InjectNacks( 0 );
+    stats.Print();
+
+    Check( aSensor.GetTemperature() == INVALID_TEMPERATURE, "temperature is invalid while sensor NACKs" );
+}
+
+/**
+ * Runs the sensor for a virtual time and counts bus traffic and fresh results
+ */
+static void RunSensor( ShtSensor &aSensor, const uint32_t aMs, LatencyStats *aStats, uint32_t &aTransactions, uint32_t &aFrames )
+{
+    const I2cBusStats bus = NativeI2cBus::Stats( 0 );
+    const uint32_t frames = Sht3x.GetStats().iFrames;
+
+    for ( uint32_t i = 0; i < aMs * 1000 / BENCH_LOOP_PERIOD_US; ++i )
+    {
+        NativeClock::Advance( BENCH_LOOP_PERIOD_US );
+
+        const uint32_t writes = NativeI2cBus::Stats( 0 ).iWrites;
+        Stopwatch watch;
+
+        watch.Start();
+        aSensor.Update();
+
+        // Only calls which touched the bus are of interest
+        if ( ( aStats != nullptr ) && ( NativeI2cBus::Stats( 0 ).iWrites != writes ) )
+        {
+            aStats->Add( watch.HostNs(), watch.VirtualUs() );
+        }
+    }
+
+    const I2cBusStats &after = NativeI2cBus::Stats( 0 );
+
+    aTransactions = ( after.iWrites - bus.iWrites ) + ( after.iReads - bus.iReads );
+    aFrames = Sht3x.GetStats().iFrames - frames;
+}
+
+/**
+ * Benchmarks periodic acquisition against single shot measurements
+ */
+static void BenchPeriodic( ShtSensor &aSensor )
+{
+    LatencyStats fetch( "ShtSensor::Update fetch" );
+    uint32_t transactions;
+    uint32_t frames;
+
+    Sht3x.SetTemperature( 21.5f );
+    Check( aSensor.StartPeriodic( PeriodicCmd::eTenMps ), "periodic mode is queued" );
+
+    RunSensor( aSensor, 10000, &fetch, transactions, frames );
+    fetch.Print();
+
+    Check( aSensor.IsPeriodic(), "sensor runs periodic mode" );
+
+    Check( ( frames >= 99 ) && ( frames <= 101 ), "periodic mode fetches one result per period" );
+    Check( fabs( aSensor.GetTemperature() - 21.5f ) < 0.01f, "periodic temperature matches device model" );
+
+    const float periodic_cost = (float) transactions / frames;
+
+    Check( aSensor.StopPeriodic(), "break is queued" );
+
+    // Settle single shot mode before measuring it
+    RunSensor( aSensor, 100, nullptr, transactions, frames );
+    Check( !aSensor.IsPeriodic(), "break stops periodic mode" );
+    RunSensor( aSensor, 10000, nullptr, transactions, frames );
+
+    printf( "bus transactions per result: periodic %.2f, single shot %.2f\n", periodic_cost, (float) transactions / frames );
+
+    Check( aSensor.StartArt(), "ART mode is queued" );
+    RunSensor( aSensor, 1000, nullptr, transactions, frames );
+    Check( ( frames >= 3 ) && ( frames <= 5 ), "ART mode acquires at 4 Hz" );
+    Check( aSensor.StopPeriodic(), "break is queued after ART mode" );
+    RunSensor( aSensor, 100, nullptr, transactions, frames );
+    Check( !aSensor.IsPeriodic(), "break stops ART mode" );
+
+    Sht3x.SetTemperature( 23.0f );
+}
+
+/**
+ * Benchmarks single shot measurements per repeatability and clock stretching
+ */
+static void BenchRepeatability( ShtSensor &aSensor )
+{
+    static const char *names[] = { "low", "medium", "high" };
+
+    uint32_t transactions;
+    uint32_t frames;
+    uint32_t rates[3];
+
+    for ( uint8_t rep = eRepeatLow; rep <= eRepeatHigh; ++rep )
+    {
+        aSensor.SetMode( (ShtRepeatability) rep );
+
+        // Let the measurement started with the previous mode finish
+        RunSensor( aSensor, 100, nullptr, transactions, frames );
+        RunSensor( aSensor, 1000, nullptr, transactions, frames );
+
+        rates[rep] = frames;
+        printf( "single shot %s repeatability: %u results/s, %.2f bus transactions per result\n",
+                names[rep], frames, (float) transactions / frames );
+    }
+
+    Check( rates[eRepeatLow] * 10 >= rates[eRepeatHigh] * 25, "low repeatability measures 2.5x faster than high" );
+
+    LatencyStats stretch( "ShtSensor::Update stretch" );
+
+    aSensor.SetMode( eRepeatLow, SingleShotCmd::eEnabled );
+    RunSensor( aSensor, 100, nullptr, transactions, frames );
+
+    const uint32_t stretches = Sht3x.GetStats().iStretches;
+
+    RunSensor( aSensor, 1000, &stretch, transactions, frames );
+    stretch.Print();
+
+    Check( Sht3x.GetStats().iStretches - stretches == frames, "every stretched read waits on the bus" );
+    Check( transactions == 2 * frames, "stretched read needs no polling" );
+    Check( fabs( aSensor.GetTemperature() - 23.0f ) < 0.01f, "stretched temperature matches device model" );
+
+    aSensor.SetMode( eRepeatHigh );
+    RunSensor( aSensor, 100, nullptr, transactions, frames );
+}
+
+/**
+ * Runs the sensor with the filter stage and the adaptive scheduler in the
+ * loop while humidity ramps, counts results of the phase
+ */
+static uint32_t RunAdaptive( ShtSensor &aSensor, AcquisitionScheduler &aScheduler, const uint32_t aMs, const float aHumPerMin )
+{
+    ReadingFilter temp( { 5, 2, 200, 3 } );
+    ReadingFilter hum( { 5, 2, 500, 3 } );
+    uint32_t results = aSensor.GetStats().iResults;
+    uint32_t count = 0;
+    float humidity = 45.0f;
+
+    for ( uint32_t i = 0; i < aMs * 1000 / BENCH_LOOP_PERIOD_US; ++i )
+    {
+        NativeClock::Advance( BENCH_LOOP_PERIOD_US );
+
+        humidity += aHumPerMin * BENCH_LOOP_PERIOD_US / 60e6f;
+        Sht3x.SetHumidity( humidity );
+        aSensor.Update();
+
+        if ( aSensor.GetStats().iResults != results )
+        {
+            results = aSensor.GetStats().iResults;
+            count++;
+
+            temp.Add( aSensor.GetTemperatureCenti() );
+            hum.Add( aSensor.GetHumidityCenti() );
+            aSensor.SetShotInterval( aScheduler.Add( millis(), temp.GetValue(), hum.GetValue() ) );
+        }
+    }
+
+    Sht3x.SetHumidity( 45.0f );
+
+    return count;
+}
+
+/**
+ * Checks the scheduler adapts to the rate of change and that the sensor
+ * measures at the scheduled interval instead of as fast as it is updated
+ */
+static void CheckAcquisition( ShtSensor &aSensor )
+{
+    AcquisitionScheduler scheduler( { 1000, 250, 10000, 50, 100 } );
+    uint32_t interval = 0;
+    uint32_t now = 0;
+
+    for ( uint8_t idx = 0; idx < 30; ++idx, now += interval )
+    {
+        interval = scheduler.Add( now, 2300, 4500 );
+    }
+
+    Check( interval == 10000, "stable conditions stretch the interval to maximum" );
+
+    // Shower raises humidity by 10 %RH per minute
+    for ( uint8_t idx = 0; idx < 6; ++idx, now += interval )
+    {
+        interval = scheduler.Add( now, 2300, 4500 + (int32_t)( now / 60 ) );
+    }
+
+    Check( interval == 250, "fast humidity rise shortens the interval to minimum" );
+
+    scheduler.SetConfig( { 0, 0, 0, 50, 100 } );
+    Check( ( scheduler.GetConfig().iMinMs == ACQUISITION_MIN_MS ) && ( scheduler.GetIntervalMs() == ACQUISITION_MIN_MS ),
+           "zero intervals are raised to the floor" );
+    scheduler.SetConfig( { 20000, 500, 5000, 50, 100 } );
+    Check( scheduler.GetIntervalMs() == 5000, "base interval is kept within bounds" );
+
+    uint32_t transactions;
+    uint32_t frames;
+
+    aSensor.SetShotInterval( 1000 );
+    RunSensor( aSensor, 100, nullptr, transactions, frames );
+    RunSensor( aSensor, 10000, nullptr, transactions, frames );
+
+    printf( "scheduled single shot at 1000 ms: %u results in 10 s, %u bus transactions\n", frames, transactions );
+    Check( ( frames >= 9 ) && ( frames <= 11 ), "sensor measures once per interval" );
+    Check( aSensor.GetIntervalMs() == 1000, "interval is reported" );
+
+    AcquisitionScheduler adaptive( { 1000, 250, 10000, 50, 100 } );
+
+    const uint32_t stable = RunAdaptive( aSensor, adaptive, 60000, 0.0f );
+    const uint32_t shower = RunAdaptive( aSensor, adaptive, 60000, 10.0f );
+    const uint32_t shower_interval = aSensor.GetIntervalMs();
+    const uint32_t settled = RunAdaptive( aSensor, adaptive, 60000, 0.0f );
+
+    printf( "adaptive results per minute: stable %u, shower %u (%u ms), settled %u (%u ms), fixed 1000 ms 60\n",
+            stable, shower, shower_interval, settled, aSensor.GetIntervalMs() );
+    Check( shower > 2 * stable, "shower is sampled faster than stable room" );
+    Check( shower_interval == 250, "shower runs at minimal interval" );
+    Check( settled < 30, "sampling slows down after the shower" );
+
+    aSensor.SetShotInterval( 0 );
+    RunSensor( aSensor, 100, nullptr, transactions, frames );
+}
+
+/**
+ * Checks the retained sample log keeps sequence numbers over overflow and
+ * brings the radio up only every Nth wake-up, on change or when urgent
+ */
+static void CheckSampleLog()
+{
+    // Zero-initialized like RTC memory at power-on
+    static RtcSampleLog log;
+    const FlushPolicy policy = { 12, 50, 300 };
+    uint32_t flushes = 0;
+
+    log.Add( { 0, 2300, 4500, RTC_LOG_TEMP_VALID | RTC_LOG_HUM_VALID } );
+    Check( log.IsFlushDue( policy, true ), "power-on flushes right away" );
+    log.FlushDone( true );
+
+    // Stable room, 120 timer wake-ups
+    for ( uint32_t wake = 1; wake <= 120; ++wake )
+    {
+        log.Add( { wake * 300, (int16_t)( 2300 + wake % 3 ), 4500, RTC_LOG_TEMP_VALID | RTC_LOG_HUM_VALID } );
+
+        if ( log.IsFlushDue( policy, false ) )
+        {
+            Check( log.GetCount() == 12, "stable log flushes every 12th wake-up" );
+            log.FlushDone( true );
+            flushes++;
+        }
+    }
+
+    printf( "retained log: radio up %u times in 120 wake-ups of a stable room\n", flushes );
+    Check( flushes == 10, "radio comes up every Nth wake-up" );
+
+    log.Add( { 121 * 300, 2300, 4900, RTC_LOG_TEMP_VALID | RTC_LOG_HUM_VALID } );
+    Check( log.IsFlushDue( policy, false ), "humidity change flushes right away" );
+    log.FlushDone( false );
+
+    log.Add( { 122 * 300, 2300, 4900, RTC_LOG_TEMP_VALID | RTC_LOG_HUM_VALID } );
+    Check( !log.IsFlushDue( policy, false ), "failed flush waits for the next period" );
+
+    // Broker outage, log overflows and drops the oldest samples
+    for ( uint32_t wake = 123; wake < 123 + RTC_LOG_CAPACITY; ++wake )
+    {
+        log.Add( { wake * 300, 2300, 4900, RTC_LOG_TEMP_VALID | RTC_LOG_HUM_VALID } );
+    }
+
+    Check( ( log.GetCount() == RTC_LOG_CAPACITY ) && ( log.iDropped == 2 ), "full log drops the oldest samples" );
+    Check( log.GetFirstSeq() == 123, "sequence numbers count dropped samples" );
+    Check( log.Get( 0 ).iTimeS == 123 * 300, "oldest kept sample follows the dropped ones" );
+
+    log.FlushDone( true );
+    Check( ( log.GetCount() == 0 ) && !log.IsFlushDue( policy, true ), "flushed log is empty" );
+}
+
+/**
+ * Replays the whole spool in bursts, checks records come in sequence
+ *
+ * @return Number of bursts
+*/
+static uint32_t ReplaySpool( TelemetrySpool &aSpool, uint32_t aSeq )
+{
+    SpoolRecord records[16];
+    uint32_t bursts = 0;
+    uint32_t gaps = 0;
+
+    while ( aSpool.GetPending() != 0 )
+    {
+        const uint8_t count = aSpool.Peek( records, 16 );
+
+        for ( uint8_t idx = 0; idx < count; ++idx )
+        {
+            gaps += ( records[idx].iSeq != aSeq );
+            aSeq = records[idx].iSeq + 1;
+        }
+
+        aSpool.Commit();
+        bursts++;
+    }
+
+    Check( gaps == 0, "replayed records are in sequence" );
+
+    return bursts;
+}
+
+/**
+ * Checks the flash spool over an outage, an overflow, reboots and damaged records
+ */
+static void CheckSpool()
+{
+    SpoolRecord records[16];
+
+    SPIFFS.Format();
+
+    TelemetrySpool spool( SPIFFS );
+    Check( spool.Begin( 1 ) == 0, "empty partition holds no records" );
+
+    // Ten minutes of outage with a sample every second
+    for ( uint32_t idx = 0; idx < 600; ++idx )
+    {
+        spool.Push( { idx * 1000, (int16_t)( 2300 + idx ), 4500, true, true, false, 0 } );
+    }
+
+    Check( spool.GetPending() == 600, "outage samples are spooled" );
+    Check( SPIFFS.GetStats().iBytesWritten == 600 * SPOOL_RECORD_SIZE, "records are written once, append only" );
+
+    Check( ( spool.Peek( records, 16 ) == 16 ) && ( records[0].iTimestamp == 0 ) &&
+           ( records[15].iTempCenti == 2315 ) && ( records[15].iBootId == 1 ), "oldest records are read back" );
+    Check( ( spool.Peek( records, 16 ) == 16 ) && ( records[0].iSeq == 0 ), "peek without commit reads the same records" );
+
+    const uint32_t bursts = ReplaySpool( spool, 0 );
+    printf( "spool: 600 samples of an outage replayed in %u bursts, %u bytes written, %u files removed\n",
+            bursts, SPIFFS.GetStats().iBytesWritten, SPIFFS.GetStats().iRemoves );
+    Check( ( spool.GetStats().iReplayed == 600 ) && ( SPIFFS.usedBytes() == 0 ), "replayed segments are removed" );
+
+    // Outage longer than the spool, the oldest segments are dropped
+    const uint32_t capacity = SPOOL_MAX_SEGMENTS * SPOOL_SEGMENT_RECORDS;
+    for ( uint32_t idx = 0; idx < capacity + 300; ++idx )
+    {
+        spool.Push( { idx * 1000, 2300, 4500, true, true, false, 0 } );
+    }
+
+    Check( spool.GetStats().iDropped == 2 * SPOOL_SEGMENT_RECORDS, "full spool drops the oldest segments" );
+    Check( spool.GetPending() == capacity + 300 - 2 * SPOOL_SEGMENT_RECORDS, "pending records exclude dropped ones" );
+    Check( SPIFFS.usedBytes() <= capacity * SPOOL_RECORD_SIZE, "spool size is bounded" );
+
+    // Reboot in the middle of a replay, the spool is rebuilt from the files
+    spool.Peek( records, 16 );
+    spool.Commit();
+
+    TelemetrySpool rebooted( SPIFFS );
+    Check( rebooted.Begin( 2 ) == capacity + 300 - 2 * SPOOL_SEGMENT_RECORDS, "records survive a reboot" );
+    Check( ( rebooted.Peek( records, 16 ) == 16 ) && ( records[0].iSeq == 600 + 2 * SPOOL_SEGMENT_RECORDS ),
+           "partly replayed segment is sent again" );
+
+    rebooted.Push( { 5000, 2300, 4500, true, true, false, 0 } );
+    Check( ReplaySpool( rebooted, 600 + 2 * SPOOL_SEGMENT_RECORDS ) != 0, "sequence continues over a reboot" );
+    Check( SPIFFS.usedBytes() == 0, "replayed spool leaves no files" );
+
+    // Flipped bit in a record and a record cut short by a power loss
+    SPIFFS.Format();
+    TelemetrySpool damaged( SPIFFS );
+    damaged.Begin( 3 );
+
+    for ( uint32_t idx = 0; idx < 40; ++idx )
+    {
+        damaged.Push( { idx * 1000, 2300, 4500, true, true, false, 0 } );
+    }
+
+    SPIFFS.Corrupt( "/spool/0.bin", 5 * SPOOL_RECORD_SIZE + 3, 0x10 );
+    SPIFFS.Truncate( "/spool/0.bin", 40 * SPOOL_RECORD_SIZE - 5 );
+
+    TelemetrySpool recovered( SPIFFS );
+    Check( recovered.Begin( 4 ) == 39, "record cut short is not counted" );
+
+    recovered.Push( { 0, 2300, 4500, true, true, false, 0 } );
+    Check( SPIFFS.exists( "/spool/1.bin" ), "damaged segment is not appended to" );
+
+    uint32_t valid = 0;
+    while ( recovered.GetPending() != 0 )
+    {
+        valid += recovered.Peek( records, 16 );
+        recovered.Commit();
+    }
+
+    Check( ( valid == 39 ) && ( recovered.GetStats().iCorrupt == 1 ), "corrupt record is skipped" );
+    Check( recovered.GetStats().iReplayed == 39, "replay counter excludes corrupt records" );
+}
+
+/**
+ * Decodes a stream cut into pieces of varying size, as TCP delivers it
+ *
+ * @return Decoded bytes
+*/
+static std::vector<uint8_t> DecodeStream( HeatshrinkDecoder &aDecoder, const std::vector<uint8_t> &aStream )
+{
+    static const size_t pieces[] = { 1, 7, 4096, 333, 2, 1460 };
+    std::vector<uint8_t> output;
+    uint8_t out[HEATSHRINK_OUT_SIZE];
+    size_t pos = 0;
+    uint8_t piece = 0;
+
+    aDecoder.Reset();
+
+    while ( pos < aStream.size() )
+    {
+        const size_t left = aStream.size() - pos;
+        const size_t size = ( pieces[piece] < left ) ? pieces[piece] : left;
+        size_t used = 0;
+        size_t produced;
+
+        piece = ( piece + 1 ) % ( sizeof pieces / sizeof pieces[0] );
+
+        // A full output buffer may leave input and a pending copy for the next call
+        do
+        {
+            size_t consumed;
+            produced = aDecoder.Decode( &aStream[pos + used], size - used, consumed, out, sizeof out );
+            used += consumed;
+            output.insert( output.end(), out, out + produced );
+        } while ( ( produced == sizeof out ) && !aDecoder.IsFailed() );
+
+        pos += size;
+    }
+
+    return output;
+}
+
+/**
+ * Checks heatshrink streams decode back to the original at any split of the
+ * input and measures the ratio on a real executable
+ */
+static void CheckHeatshrink()
+{
+    HeatshrinkDecoder decoder;
+
+    // Literal 'a', then 7 bytes copied from offset 1, zero padded
+    const std::vector<uint8_t> vector = { 0xB0, 0x80, 0x03, 0x00 };
+    const std::vector<uint8_t> expected( 8, 'a' );
+    Check( DecodeStream( decoder, vector ) == expected, "reference stream decodes to eight bytes" );
+
+    // Machine code of this harness stands in for a firmware image
+    std::vector<uint8_t> image( HEATSHRINK_IMAGE_SIZE );
+    FILE *exe = fopen( "/proc/self/exe", "rb" );
+    const size_t size = exe ? fread( image.data(), 1, image.size(), exe ) : 0;
+    if ( exe )
+    {
+        fclose( exe );
+    }
+    image.resize( size );
+    Check( size > 0, "image is read" );
+
+    HeatshrinkEncoder encoder;
+    const std::vector<uint8_t> stream = encoder.Encode( image.data(), image.size() );
+
+    Stopwatch watch;
+    watch.Start();
+    const std::vector<uint8_t> decoded = DecodeStream( decoder, stream );
+    const uint64_t ns = watch.HostNs();
+
+    Check( decoded == image, "decoded image equals the original" );
+    Check( !decoder.IsFailed() && ( decoder.GetTotal() == image.size() ), "decoder counts the whole image" );
+
+    printf( "heatshrink w%u l%u: %u -> %u bytes (%u %%), decoded at %.1f MB/s on host\n",
+            HEATSHRINK_WINDOW_BITS, HEATSHRINK_LOOKAHEAD_BITS, (unsigned) image.size(), (unsigned) stream.size(),
+            (unsigned)( stream.size() * 100 / ( image.size() ? image.size() : 1 ) ), ns ? image.size() * 1000.0 / ns : 0.0 );
+
+    // A stream starting with a back-reference points before its start
+    const std::vector<uint8_t> corrupt = { 0x00, 0x00, 0x00 };
+    DecodeStream( decoder, corrupt );
+    Check( decoder.IsFailed() && ( decoder.GetTotal() == 0 ), "reference before the stream start fails" );
+}
+
+static CoopScheduler Jobs;
+static uint8_t JobTrace[16];
+static uint8_t JobTraceCount = 0;
+static uint8_t SensorJob;
+
+static void TraceJob( const uint8_t aJob )
+{
+    if ( JobTraceCount < sizeof JobTrace )
+    {
+        JobTrace[JobTraceCount++] = aJob;
+    }
+}
+
+static void FastJob()
+{
+    TraceJob( 0 );
+    NativeClock::Advance( 100 );
+}
+
+static void SlowJob()
+{
+    TraceJob( 1 );
+}
+
+static void OneShotJob()
+{
+    TraceJob( 2 );
+}
+
+static void SensorStep()
+{
+    Buses.Update();
+    Jobs.SetDeadline( SensorJob, Buses.GetDeadlineUs( 1000000 ) );
+}
+
+/**
+ * Runs the scheduler for a virtual time, sleeping as long as it asks for,
+ * and returns number of wake-ups
+ */
+static uint32_t RunJobs( CoopScheduler &aJobs, const uint32_t aMs )
+{
+    const uint64_t end = NativeClock::NowUs() + aMs * 1000ULL;
+    uint32_t wakeups = 0;
+
+    while ( NativeClock::NowUs() < end )
+    {
+        const uint32_t wait = aJobs.Run( 1000000 );
+
+        wakeups++;
+        NativeClock::Advance( ( wait > 0 ) ? wait : 1 );
+    }
+
+    return wakeups;
+}
+
+/**
+ * Checks deadline order, periodic and one-shot jobs and idle accounting of
+ * the cooperative scheduler, then runs the sensor from it instead of polling
+ */
+static void CheckScheduler( ShtSensor &aSensor )
+{
+    CoopScheduler jobs;
+
+    const uint8_t slow = jobs.AddPeriodic( "slow", SlowJob, 50000, 25000 );
+    const uint8_t fast = jobs.AddPeriodic( "fast", FastJob, 10000, 10000 );
+    const uint8_t once = jobs.AddOneShot( "once", OneShotJob, 15000 );
+
+    RunJobs( jobs, 30 );
+
+    Check( ( JobTraceCount == 4 ) && ( JobTrace[0] == 0 ) && ( JobTrace[1] == 2 ) && ( JobTrace[2] == 0 ) && ( JobTrace[3] == 1 ),
+           "jobs run in deadline order" );
+
+    RunJobs( jobs, 975 );
+
+    Check( jobs.GetStats( fast ).iRuns == 100, "periodic job runs once a period" );
+    Check( jobs.GetStats( slow ).iRuns == 20, "slower periodic job runs once a period" );
+    Check( jobs.GetStats( once ).iRuns == 1, "one-shot job runs once" );
+
+    jobs.Trigger( once, 5000 );
+    RunJobs( jobs, 10 );
+
+    Check( jobs.GetStats( once ).iRuns == 2, "triggered one-shot job runs again" );
+    Check( jobs.GetMaxLatenessUs() <= 100, "jobs start on time while the task sleeps between them" );
+
+    // Fast job is busy 100 us every 10 ms
+    printf( "scheduler: idle %u per mille, %u us busy in %u us\n", jobs.GetIdlePermille(),
+            (unsigned) jobs.GetBusyUs(), (unsigned)( jobs.GetBusyUs() + jobs.GetIdleUs() ) );
+    Check( ( jobs.GetIdlePermille() >= 989 ) && ( jobs.GetIdlePermille() <= 991 ), "idle time is accounted" );
+
+    // Sensor job wakes only when the bus manager has work instead of every loop pass
+    Buses.Add( aSensor );
+    aSensor.SetShotInterval( 1000 );
+    SensorJob = Jobs.AddOneShot( "sensor", SensorStep, 0 );
+
+    const uint32_t results = aSensor.GetStats().iResults;
+    const uint32_t wakeups = RunJobs( Jobs, 10000 );
+    const uint32_t measured = aSensor.GetStats().iResults - results;
+
+    printf( "scheduled sensor: %u results in 10 s with %u wake-ups, polling loop wakes %u times\n",
+            measured, wakeups, 10000 * 1000 / BENCH_LOOP_PERIOD_US );
+    Check( ( measured >= 9 ) && ( measured <= 11 ), "scheduled sensor measures once per interval" );
+    Check( wakeups <= measured * 4, "task wakes only for sensor transactions" );
+
+    aSensor.SetShotInterval( 0 );
+}
+
+/**
+ * Checks two sensors on one bus keep their own transaction state and that
+ * the engine counts bus errors and timeouts
+ */
+static void CheckEngine( ShtSensor &aSensor )
+{
+    Sht3xDeviceModel second;
+    ShtSensor other = ShtSensor( Buses.GetWire( 0 ), SHT_I2C_DEFAULT_ADDR + 1 );
+    uint32_t transactions;
+    uint32_t frames;
+
+    second.Attach( 0, SHT_I2C_DEFAULT_ADDR + 1 );
+    second.SetTemperature( 30.0f );
+
+    for ( uint32_t i = 0; i < 100; ++i )
+    {
+        NativeClock::Advance( BENCH_LOOP_PERIOD_US );
+        aSensor.Update();
+        other.Update();
+    }
+
+    Check( fabs( aSensor.GetTemperature() - 23.0f ) < 0.01f, "first sensor keeps its own result" );
+    Check( fabs( other.GetTemperature() - 30.0f ) < 0.01f, "second sensor keeps its own result" );
+    Check( other.GetStats().iCommands > 1, "second sensor measures on its own" );
+
+    NativeI2cBus::Detach( 0, SHT_I2C_DEFAULT_ADDR + 1 );
+
+    // A late result is polled until it comes, a missing one times out
+    const ShtSensorStats before = aSensor.GetStats();
+
+    Sht3x.InjectDelay( 3000 );
+    RunSensor( aSensor, 100, nullptr, transactions, frames );
+    Sht3x.InjectDelay( 0 );
+
+    Check( aSensor.GetStats().iNotReady > before.iNotReady, "late result is polled" );
+    Check( aSensor.GetStats().iTimeouts == before.iTimeouts, "late result does not time out" );
+    Check( aSensor.GetStats().iNotReady - before.iNotReady <= frames * ( 3000 / BENCH_LOOP_PERIOD_US + 1 ),
+           "late result is polled once per loop pass at most" );
+
+    Sht3x.InjectDelay( 30000 );
+    RunSensor( aSensor, 100, nullptr, transactions, frames );
+    Sht3x.InjectDelay( 0 );
+    RunSensor( aSensor, 100, nullptr, transactions, frames );
+
+    Check( aSensor.GetStats().iTimeouts > before.iTimeouts, "missing result times out" );
+
+    Sht3x.InjectNacks( 10 );
+    RunSensor( aSensor, 100, nullptr, transactions, frames );
+
+    Check( aSensor.GetStats().iBusErrors >= before.iBusErrors + 10, "NACKed commands are counted" );
+    Check( aSensor.GetTemperature() != INVALID_TEMPERATURE, "sensor recovers after NACKs" );
+}
+
+/**
+ * Runs sensors scheduled by a bus manager and counts results of every device
+ */
+static void RunBuses( I2cBusManager &aBuses, Sht3xDeviceModel *aDevices[], const uint8_t aCount, uint32_t aResults[] )
+{
+    uint32_t frames[3];
+
+    for ( uint8_t dev = 0; dev < aCount; ++dev )
+    {
+        frames[dev] = aDevices[dev]->GetStats().iFrames;
+    }
+
+    const uint64_t end = NativeClock::NowUs() + 1000000;
+
+    while ( NativeClock::NowUs() < end )
+    {
+        NativeClock::Advance( BENCH_LOOP_PERIOD_US );
+        aBuses.Update();
+    }
+
+    for ( uint8_t dev = 0; dev < aCount; ++dev )
+    {
+        aResults[dev] = aDevices[dev]->GetStats().iFrames - frames[dev];
+    }
+}
+
+/**
+ * Benchmarks three sensors on two buses with overlapping conversions against
+ * sensors blocking the loop by clock stretching one after another
+ */
+static void BenchPipeline()
+{
+    I2cBusManager buses;
+    Sht3xDeviceModel second;
+    Sht3xDeviceModel third;
+    Sht3xDeviceModel *devices[] = { &Sht3x, &second, &third };
+
+    buses.Begin( 0, 21, 22, SHT_I2C_FREQUENCY_HZ );
+    buses.Begin( 1, 16, 17, SHT_I2C_FREQUENCY_HZ );
+    second.Attach( 0, SHT_I2C_DEFAULT_ADDR + 1 );
+    third.Attach( 1, SHT_I2C_DEFAULT_ADDR );
+
+    ShtSensor sensors[] =
+    {
+        ShtSensor( buses.GetWire( 0 ) ),
+        ShtSensor( buses.GetWire( 0 ), SHT_I2C_DEFAULT_ADDR + 1 ),
+        ShtSensor( buses.GetWire( 1 ) )
+    };
+
+    uint32_t pipelined[3];
+    uint32_t blocking[3];
+    uint32_t settled[3];
+
+    for ( ShtSensor &sensor : sensors )
+    {
+        Check( buses.Add( sensor ), "bus manager accepts sensor" );
+    }
+
+    RunBuses( buses, devices, 3, pipelined );
+
+    for ( ShtSensor &sensor : sensors )
+    {
+        sensor.SetMode( eRepeatHigh, SingleShotCmd::eEnabled );
+    }
+
+    RunBuses( buses, devices, 3, blocking );
+
+    for ( ShtSensor &sensor : sensors )
+    {
+        sensor.SetMode( eRepeatHigh );
+    }
+
+    // Let the last measurements finish before the devices go away
+    RunBuses( buses, devices, 3, settled );
+
+    printf( "3 sensors, high repeatability: pipelined %u/%u/%u results/s, blocking %u/%u/%u results/s\n",
+            pipelined[0], pipelined[1], pipelined[2], blocking[0], blocking[1], blocking[2] );
+
+    for ( uint8_t dev = 0; dev < 3; ++dev )
+    {
+        Check( pipelined[dev] >= 55, "pipelined sensor measures at full rate" );
+        Check( pipelined[dev] >= 2 * blocking[dev], "pipelining beats blocking reads" );
+    }
+
+    NativeI2cBus::Detach( 0, SHT_I2C_DEFAULT_ADDR + 1 );
+    NativeI2cBus::Detach( 1, SHT_I2C_DEFAULT_ADDR );
+}
+
+/**
+ * Replays a recorded bus trace and checks the driver follows it
+ */
+static void ReplayTrace( ShtSensor &aSensor )
+{
+    Check( Sht3x.LoadTrace( kRecordedTrace ), "recorded trace parses" );
+
+    const uint32_t mismatches = Sht3x.GetStats().iTraceMismatches;
+
+    // Run the driver long enough to consume both cycles
+    for ( uint32_t i = 0; i < 100; ++i )
+    {
+        NativeClock::Advance( BENCH_LOOP_PERIOD_US );
+        aSensor.Update();
+    }
+
+    Check( Sht3x.GetStats().iTraceMismatches == mismatches, "driver commands match recorded trace" );
+}
+
+int main()
+{
+    Serial.Mute( true );
+
+    Sht3x.Attach( 0, SHT_I2C_DEFAULT_ADDR );
+    Sht3x.SetTemperature( 23.0f );
+    Sht3x.SetHumidity( 45.0f );
+
+    Buses.Begin( 0, 21, 22, SHT_I2C_FREQUENCY_HZ );
+
+    ShtSensor sensor = ShtSensor( Buses.GetWire( 0 ) );
+    MotionSensor motion = MotionSensor( MOTION_SENSOR_PIN );
+
+    CheckMotionEvents( motion );
+    StressSpscQueue();
+
+    LatencyStats::PrintHeader();
+
+    BenchUpdate( sensor );
+    BenchLoop( sensor, motion );
+    BenchTelemetryCodec( sensor, motion );
+    BenchCrc();
+    BenchFixedPoint();
+    CheckSampleBatch();
+    CheckChangeDetector();
+    CheckReadingFilter();
+    CheckSampleLog();
+    CheckSpool();
+    CheckHeatshrink();
+    BenchSpscQueue();
+    BenchNack( sensor );
+    ReplayTrace( sensor );
+    BenchPeriodic( sensor );
+    BenchRepeatability( sensor );
+    CheckAcquisition( sensor );
+    CheckScheduler( sensor );
+    CheckEngine( sensor );
+    BenchPipeline();
+
+    const I2cBusStats &bus = NativeI2cBus::Stats( 0 );
+    const Sht3xDeviceModel::Stats &dev = Sht3x.GetStats();
+
+    printf( "\nbus: %u writes, %u reads, %u NACKs, %llu us busy\n",
+            bus.iWrites, bus.iReads, bus.iNacks, (unsigned long long) bus.iBusyUs );
+    printf( "sht3x: %u commands, %u frames, %u NACKs, %u trace mismatches\n",
+            dev.iCommands, dev.iFrames, dev.iNacks, dev.iTraceMismatches );
+
+    return ( Failures == 0 ) ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "AcquisitionScheduler.h"
+
+int32_t AcquisitionScheduler::GetSlope( const int32_t aLast, const int32_t aNew, const uint32_t aElapsedMs )
+{
+    if ( aElapsedMs == 0 )
+    {
+        return 0;
+    }
+
+    return (int32_t)( (int64_t)( aNew - aLast ) * 60000 / aElapsedMs );
+}
+
+void AcquisitionScheduler::SetConfig( const AcquisitionConfig &aConfig )
+{
+    iConfig = aConfig;
+
+    // A zero interval would make the sensor measure back to back
+    if ( iConfig.iMinMs < ACQUISITION_MIN_MS )
+    {
+        iConfig.iMinMs = ACQUISITION_MIN_MS;
+    }
+
+    if ( iConfig.iMaxMs < iConfig.iMinMs )
+    {
+        iConfig.iMaxMs = iConfig.iMinMs;
+    }
+
+    iConfig.iBaseMs = ( iConfig.iBaseMs < iConfig.iMinMs ) ? iConfig.iMinMs :
+                      ( iConfig.iBaseMs > iConfig.iMaxMs ) ? iConfig.iMaxMs : iConfig.iBaseMs;
+
+    iIntervalMs = iConfig.iBaseMs;
+}
+
+uint32_t AcquisitionScheduler::Add( const uint32_t aTimestamp, const int32_t aTempCenti, const int32_t aHumCenti )
+{
+    if ( iHasLast )
+    {
+        const uint32_t elapsed = aTimestamp - iLastMs;
+
+        // Halfway smoothing, a single noisy result does not switch the rate
+        iTempSlope += ( GetSlope( iLastTemp, aTempCenti, elapsed ) - iTempSlope ) / 2;
+        iHumSlope += ( GetSlope( iLastHum, aHumCenti, elapsed ) - iHumSlope ) / 2;
+    }
+
+    iLastMs = aTimestamp;
+    iLastTemp = aTempCenti;
+    iLastHum = aHumCenti;
+    iHasLast = true;
+
+    const int32_t temp = ( iTempSlope < 0 ) ? -iTempSlope : iTempSlope;
+    const int32_t hum = ( iHumSlope < 0 ) ? -iHumSlope : iHumSlope;
+
+    const bool fast = ( temp >= iConfig.iTempFastCenti ) || ( hum >= iConfig.iHumFastCenti );
+    const bool stable = ( temp * ACQUISITION_STABLE_DIVISOR < iConfig.iTempFastCenti ) &&
+                        ( hum * ACQUISITION_STABLE_DIVISOR < iConfig.iHumFastCenti );
+
+    if ( fast )
+    {
+        iIntervalMs /= 2;
+    }
+    else if ( stable )
+    {
+        iIntervalMs += iIntervalMs / 4 + 1;
+    }
+    else if ( iIntervalMs < iConfig.iBaseMs )
+    {
+        iIntervalMs = ( iIntervalMs * 2 < iConfig.iBaseMs ) ? iIntervalMs * 2 : iConfig.iBaseMs;
+    }
+    else
+    {
+        iIntervalMs -= ( iIntervalMs - iConfig.iBaseMs ) / 4;
+    }
+
+    iIntervalMs = ( iIntervalMs < iConfig.iMinMs ) ? iConfig.iMinMs : iIntervalMs;
+    iIntervalMs = ( iIntervalMs > iConfig.iMaxMs ) ? iConfig.iMaxMs : iIntervalMs;
+
+    return iIntervalMs;
+}
@@ -0,0 +1,121 @@
+#ifndef __ACQUISITION_SCHEDULER_H__
+#define __ACQUISITION_SCHEDULER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Slope below a fraction of the fast one is stable and slows sampling down
+ */
+#define ACQUISITION_STABLE_DIVISOR  4
+
+/**
+ * Shortest interval between two measurements in milliseconds
+ */
+#define ACQUISITION_MIN_MS          100
+
+/**
+ * Configuration of adaptive acquisition, intervals in milliseconds
+ */
+struct AcquisitionConfig
+{
+    /**
+     * Interval while values change moderately
+    */
+    uint32_t iBaseMs;
+
+    /**
+     * Bounds of the interval during fast changes and stable conditions
+    */
+    uint32_t iMinMs;
+    uint32_t iMaxMs;
+
+    /**
+     * Slopes in hundredths of the unit per minute considered a fast change
+    */
+    uint16_t iTempFastCenti;
+    uint16_t iHumFastCenti;
+};
+
+/**
+ * Chooses time between two measurements from the observed rate of change
+ *
+ * A fast change of either quantity halves the interval at once, stable
+ * conditions stretch it by a quarter per result and anything in between
+ * returns it towards the base interval.
+ */
+class AcquisitionScheduler
+{
+    AcquisitionConfig iConfig;
+
+    uint32_t iIntervalMs;
+
+    /**
+     * The previous result, invalid until first result
+    */
+    uint32_t iLastMs;
+    int32_t iLastTemp;
+    int32_t iLastHum;
+    bool iHasLast;
+
+    /**
+     * Smoothed slopes in hundredths of the unit per minute
+    */
+    int32_t iTempSlope;
+    int32_t iHumSlope;
+
+    /**
+     * Returns slope between two results, zero if they are not apart in time
+    */
+    static int32_t GetSlope( const int32_t aLast, const int32_t aNew, const uint32_t aElapsedMs );
+
+    public:
+        AcquisitionScheduler( const AcquisitionConfig &aConfig ):
+            iLastMs( 0 ),
+            iLastTemp( 0 ),
+            iLastHum( 0 ),
+            iHasLast( false ),
+            iTempSlope( 0 ),
+            iHumSlope( 0 )
+        {
+            SetConfig( aConfig );
+        }
+
+        /**
+         * Adapts the interval to a new result
+         *
+         * @param aTimestamp time of the result in milliseconds
+         * @param aTempCenti temperature in 0.01 degC
+         * @param aHumCenti humidity in 0.01 %RH
+         * @return time to the next measurement in milliseconds
+        */
+        uint32_t Add( const uint32_t aTimestamp, const int32_t aTempCenti, const int32_t aHumCenti );
+
+        uint32_t GetIntervalMs() const
+        {
+            return iIntervalMs;
+        }
+
+        int32_t GetTempSlope() const
+        {
+            return iTempSlope;
+        }
+
+        int32_t GetHumSlope() const
+        {
+            return iHumSlope;
+        }
+
+        /**
+         * Applies new configuration and restarts from the base interval,
+         * intervals are brought to ACQUISITION_MIN_MS <= min <= base <= max
+        */
+        void SetConfig( const AcquisitionConfig &aConfig );
+
+        const AcquisitionConfig& GetConfig() const
+        {
+            return iConfig;
+        }
+};
+
+#endif /* __ACQUISITION_SCHEDULER_H__ */
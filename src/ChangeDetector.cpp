@@ -0,0 +1,59 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "ChangeDetector.h"
+
+bool ChangeDetector::IsSignificant( const int32_t aLast, const int32_t aNew, const Deadband &aBand )
+{
+    const int32_t delta = ( aNew > aLast ) ? aNew - aLast : aLast - aNew;
+    const int32_t magnitude = ( aLast < 0 ) ? -aLast : aLast;
+    const int32_t relative = magnitude * aBand.iRelPermille / 1000;
+    const int32_t threshold = ( relative > aBand.iAbsCenti ) ? relative : aBand.iAbsCenti;
+
+    // Without any threshold every change is significant
+    return ( threshold == 0 ) ? ( delta != 0 ) : ( delta >= threshold );
+}
+
+bool ChangeDetector::Evaluate( const TelemetrySample &aSample )
+{
+    bool changed = !iHasLast;
+    bool heartbeat = false;
+
+    if ( iHasLast )
+    {
+        const uint32_t elapsed = aSample.iTimestamp - iLast.iTimestamp;
+
+        if ( elapsed < iConfig.iMinIntervalMs )
+        {
+            iSuppressed++;
+            return false;
+        }
+
+        changed = ( aSample.iMovement != iLast.iMovement ) ||
+                  ( aSample.iTempValid != iLast.iTempValid ) ||
+                  ( aSample.iHumValid != iLast.iHumValid ) ||
+                  ( aSample.iTempValid && IsSignificant( iLast.iTempCenti, aSample.iTempCenti, iConfig.iTemp ) ) ||
+                  ( aSample.iHumValid && IsSignificant( iLast.iHumCenti, aSample.iHumCenti, iConfig.iHum ) );
+
+        heartbeat = elapsed >= iConfig.iHeartbeatMs;
+    }
+
+    if ( !changed && !heartbeat )
+    {
+        iSuppressed++;
+        return false;
+    }
+
+    if ( changed )
+    {
+        iChangeReports++;
+    }
+    else
+    {
+        iHeartbeatReports++;
+    }
+
+    iLast = aSample;
+    iHasLast = true;
+
+    return true;
+}
@@ -0,0 +1,122 @@
+#ifndef __CHANGE_DETECTOR_H__
+#define __CHANGE_DETECTOR_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "TelemetryCodec.h"
+
+/**
+ * Deadband of one reported quantity
+ *
+ * A change is significant when it reaches the larger of both thresholds, so
+ * the absolute one acts as a noise floor near zero. Zero disables a threshold.
+ */
+struct Deadband
+{
+    /**
+     * Absolute threshold in hundredths of the unit
+    */
+    uint16_t iAbsCenti;
+
+    /**
+     * Threshold relative to the last reported value in per mille
+    */
+    uint16_t iRelPermille;
+};
+
+/**
+ * Configuration of report-on-change
+ */
+struct ChangeConfig
+{
+    bool iEnabled;
+
+    Deadband iTemp;
+    Deadband iHum;
+
+    /**
+     * Longest time without a report in milliseconds
+    */
+    uint32_t iHeartbeatMs;
+
+    /**
+     * Shortest time between two reports in milliseconds
+    */
+    uint32_t iMinIntervalMs;
+};
+
+class ChangeDetector
+{
+    ChangeConfig iConfig;
+
+    /**
+     * The last reported sample, invalid until first report
+    */
+    TelemetrySample iLast;
+    bool iHasLast;
+
+    /**
+     * Number of reports caused by a change and by the heartbeat
+    */
+    uint32_t iChangeReports;
+    uint32_t iHeartbeatReports;
+
+    /**
+     * Number of evaluated samples which were not reported
+    */
+    uint32_t iSuppressed;
+
+    static bool IsSignificant( const int32_t aLast, const int32_t aNew, const Deadband &aBand );
+
+    public:
+        ChangeDetector( const ChangeConfig &aConfig ):
+            iConfig( aConfig ),
+            iLast{},
+            iHasLast( false ),
+            iChangeReports( 0 ),
+            iHeartbeatReports( 0 ),
+            iSuppressed( 0 )
+        {
+        }
+
+        void SetConfig( const ChangeConfig &aConfig )
+        {
+            iConfig = aConfig;
+        }
+
+        const ChangeConfig& GetConfig() const
+        {
+            return iConfig;
+        }
+
+        bool IsEnabled() const
+        {
+            return iConfig.iEnabled;
+        }
+
+        /**
+         * Decides if a sample has to be reported and remembers it as the last
+         * reported one if so
+         *
+         * @param aSample current sample, its timestamp is used as current time
+         * @return True if sample changed significantly or heartbeat elapsed
+        */
+        bool Evaluate( const TelemetrySample &aSample );
+
+        uint32_t GetChangeReports() const
+        {
+            return iChangeReports;
+        }
+
+        uint32_t GetHeartbeatReports() const
+        {
+            return iHeartbeatReports;
+        }
+
+        uint32_t GetSuppressed() const
+        {
+            return iSuppressed;
+        }
+};
+
+#endif /* __CHANGE_DETECTOR_H__ */
@@ -0,0 +1,174 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <Arduino.h>
+#include "CoopScheduler.h"
+
+uint8_t CoopScheduler::AddJob( const char *aName, JobFunction aFunction, const uint32_t aPeriodUs, const uint32_t aDelayUs )
+{
+    if ( iJobCount >= SCHEDULER_MAX_JOBS )
+    {
+        return SCHEDULER_NO_JOB;
+    }
+
+    const uint8_t job = iJobCount++;
+
+    iJobs[job].iName = aName;
+    iJobs[job].iFunction = aFunction;
+    iJobs[job].iPeriodUs = aPeriodUs;
+    iJobs[job].iStats = {};
+
+    Trigger( job, aDelayUs );
+
+    return job;
+}
+
+void CoopScheduler::Enqueue( const uint8_t aJob )
+{
+    uint8_t pos = iQueued;
+
+    // Behind every job due at the same time or sooner, relative to the new deadline
+    while ( ( pos > 0 ) && ( (int32_t)( iJobs[iQueue[pos - 1]].iDeadlineUs - iJobs[aJob].iDeadlineUs ) > 0 ) )
+    {
+        iQueue[pos] = iQueue[pos - 1];
+        pos--;
+    }
+
+    iQueue[pos] = aJob;
+    iQueued++;
+    iJobs[aJob].iArmed = true;
+}
+
+void CoopScheduler::Dequeue( const uint8_t aJob )
+{
+    if ( !iJobs[aJob].iArmed )
+    {
+        return;
+    }
+
+    uint8_t pos = 0;
+
+    while ( iQueue[pos] != aJob )
+    {
+        pos++;
+    }
+
+    for ( ; pos + 1 < iQueued; ++pos )
+    {
+        iQueue[pos] = iQueue[pos + 1];
+    }
+
+    iQueued--;
+    iJobs[aJob].iArmed = false;
+}
+
+void CoopScheduler::SetDeadline( const uint8_t aJob, const uint32_t aDeadlineUs )
+{
+    if ( aJob >= iJobCount )
+    {
+        return;
+    }
+
+    Dequeue( aJob );
+    iJobs[aJob].iDeadlineUs = aDeadlineUs;
+    Enqueue( aJob );
+}
+
+void CoopScheduler::SetPeriod( const uint8_t aJob, const uint32_t aPeriodUs )
+{
+    if ( aJob < iJobCount )
+    {
+        iJobs[aJob].iPeriodUs = aPeriodUs;
+    }
+}
+
+void CoopScheduler::Cancel( const uint8_t aJob )
+{
+    if ( aJob < iJobCount )
+    {
+        Dequeue( aJob );
+    }
+}
+
+uint32_t CoopScheduler::Run( const uint32_t aMaxWaitUs )
+{
+    const uint32_t start = micros();
+    uint8_t ran = 0;
+
+    if ( iStarted )
+    {
+        iIdleUs += start - iLastRunEndUs;
+    }
+
+    while ( iQueued != 0 )
+    {
+        const uint8_t job_id = iQueue[0];
+        Job &job = iJobs[job_id];
+        const uint32_t now = micros();
+        const int32_t lateness = (int32_t)( now - job.iDeadlineUs );
+
+        // Not due yet, or due again after running in this pass
+        if ( ( lateness < 0 ) || ( ran & ( 1 << job_id ) ) )
+        {
+            break;
+        }
+
+        ran |= 1 << job_id;
+        Dequeue( job_id );
+
+        // Periodic jobs keep their phase, missed periods are skipped
+        if ( job.iPeriodUs != 0 )
+        {
+            const uint32_t missed = (uint32_t) lateness / job.iPeriodUs;
+
+            job.iDeadlineUs += ( missed + 1 ) * job.iPeriodUs;
+            Enqueue( job_id );
+        }
+
+        job.iFunction();
+
+        const uint32_t run = micros() - now;
+
+        job.iStats.iRuns++;
+        job.iStats.iMaxLatenessUs = ( (uint32_t) lateness > job.iStats.iMaxLatenessUs ) ? lateness : job.iStats.iMaxLatenessUs;
+        job.iStats.iMaxRunUs = ( run > job.iStats.iMaxRunUs ) ? run : job.iStats.iMaxRunUs;
+    }
+
+    const uint32_t end = micros();
+
+    iBusyUs += end - start;
+    iLastRunEndUs = end;
+    iStarted = true;
+
+    if ( iQueued == 0 )
+    {
+        return aMaxWaitUs;
+    }
+
+    const int32_t wait = (int32_t)( iJobs[iQueue[0]].iDeadlineUs - end );
+
+    if ( wait <= 0 )
+    {
+        return 0;
+    }
+
+    return ( (uint32_t) wait < aMaxWaitUs ) ? wait : aMaxWaitUs;
+}
+
+uint16_t CoopScheduler::GetIdlePermille() const
+{
+    const uint64_t total = iBusyUs + iIdleUs;
+
+    return ( total == 0 ) ? 0 : (uint16_t)( iIdleUs * 1000 / total );
+}
+
+uint32_t CoopScheduler::GetMaxLatenessUs() const
+{
+    uint32_t lateness = 0;
+
+    for ( uint8_t job = 0; job < iJobCount; ++job )
+    {
+        lateness = ( iJobs[job].iStats.iMaxLatenessUs > lateness ) ? iJobs[job].iStats.iMaxLatenessUs : lateness;
+    }
+
+    return lateness;
+}
@@ -0,0 +1,216 @@
+#ifndef __COOP_SCHEDULER_H__
+#define __COOP_SCHEDULER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <Arduino.h>
+
+/**
+ * Maximal number of jobs of a scheduler, each job runs at most once per Run()
+ */
+#define SCHEDULER_MAX_JOBS      8
+
+/**
+ * Returned instead of a job identifier when there is no free slot
+ */
+#define SCHEDULER_NO_JOB        0xFF
+
+/**
+ * Function of a job, must return quickly and never wait for hardware
+ */
+typedef void ( *JobFunction )();
+
+/**
+ * Counters of a job
+ */
+struct JobStats
+{
+    uint32_t iRuns;
+
+    /**
+     * Longest time from the deadline to the start of the job
+    */
+    uint32_t iMaxLatenessUs;
+
+    /**
+     * Longest run of the job
+    */
+    uint32_t iMaxRunUs;
+};
+
+/**
+ * Cooperative scheduler of periodic and one-shot jobs ordered by deadline
+ *
+ * Run() starts every due job in deadline order and returns time to the next
+ * deadline, so the caller may sleep instead of spinning. Time outside Run()
+ * is accounted as idle.
+ */
+class CoopScheduler
+{
+    struct Job
+    {
+        const char *iName;
+        JobFunction iFunction;
+
+        /**
+         * Time the job is due, micros(), valid if armed
+        */
+        uint32_t iDeadlineUs;
+
+        /**
+         * Time between two runs, zero for a one-shot job
+        */
+        uint32_t iPeriodUs;
+
+        bool iArmed;
+
+        JobStats iStats;
+    };
+
+    Job iJobs[SCHEDULER_MAX_JOBS];
+    uint8_t iJobCount;
+
+    /**
+     * Armed jobs ordered by deadline, equal deadlines in order of arming
+    */
+    uint8_t iQueue[SCHEDULER_MAX_JOBS];
+    uint8_t iQueued;
+
+    /**
+     * Time spent in jobs and outside Run() since the first Run()
+    */
+    uint64_t iBusyUs;
+    uint64_t iIdleUs;
+
+    /**
+     * End of the last Run(), valid once started
+    */
+    uint32_t iLastRunEndUs;
+    bool iStarted;
+
+    uint8_t AddJob( const char *aName, JobFunction aFunction, const uint32_t aPeriodUs, const uint32_t aDelayUs );
+
+    /**
+     * Inserts an armed job into the deadline ordered queue
+    */
+    void Enqueue( const uint8_t aJob );
+
+    /**
+     * Removes a job from the queue if it is there
+    */
+    void Dequeue( const uint8_t aJob );
+
+    public:
+        CoopScheduler():
+            iJobs{},
+            iJobCount( 0 ),
+            iQueue{},
+            iQueued( 0 ),
+            iBusyUs( 0 ),
+            iIdleUs( 0 ),
+            iLastRunEndUs( 0 ),
+            iStarted( false )
+        {
+        }
+
+        /**
+         * Adds a job running once a period
+         *
+         * @param aName name of the job
+         * @param aFunction function of the job
+         * @param aPeriodUs time between two deadlines
+         * @param aDelayUs time to the first deadline
+         * @return identifier of the job or SCHEDULER_NO_JOB
+        */
+        uint8_t AddPeriodic( const char *aName, JobFunction aFunction, const uint32_t aPeriodUs, const uint32_t aDelayUs = 0 )
+        {
+            return AddJob( aName, aFunction, aPeriodUs, aDelayUs );
+        }
+
+        /**
+         * Adds a job running once, it may be armed again by Trigger()
+         *
+         * @param aName name of the job
+         * @param aFunction function of the job
+         * @param aDelayUs time to the deadline
+         * @return identifier of the job or SCHEDULER_NO_JOB
+        */
+        uint8_t AddOneShot( const char *aName, JobFunction aFunction, const uint32_t aDelayUs )
+        {
+            return AddJob( aName, aFunction, 0, aDelayUs );
+        }
+
+        /**
+         * Arms a job to run after a delay, also moves the next run of a periodic job
+         *
+         * @param aJob identifier of the job
+         * @param aDelayUs time to the deadline
+        */
+        void Trigger( const uint8_t aJob, const uint32_t aDelayUs )
+        {
+            SetDeadline( aJob, micros() + aDelayUs );
+        }
+
+        /**
+         * Arms a job to run at a deadline, may be called from the job itself
+         *
+         * @param aJob identifier of the job
+         * @param aDeadlineUs deadline, micros()
+        */
+        void SetDeadline( const uint8_t aJob, const uint32_t aDeadlineUs );
+
+        /**
+         * Changes period of a job, takes effect after its next run
+        */
+        void SetPeriod( const uint8_t aJob, const uint32_t aPeriodUs );
+
+        /**
+         * Disarms a job until it is triggered again
+        */
+        void Cancel( const uint8_t aJob );
+
+        /**
+         * Runs due jobs, earliest deadline first, each at most once
+         *
+         * @param aMaxWaitUs longest time to return when no job is armed
+         * @return time to the next deadline in microseconds, zero if a job is due
+        */
+        uint32_t Run( const uint32_t aMaxWaitUs );
+
+        const JobStats& GetStats( const uint8_t aJob ) const
+        {
+            return iJobs[aJob].iStats;
+        }
+
+        const char* GetName( const uint8_t aJob ) const
+        {
+            return iJobs[aJob].iName;
+        }
+
+        uint8_t GetJobCount() const
+        {
+            return iJobCount;
+        }
+
+        uint64_t GetBusyUs() const
+        {
+            return iBusyUs;
+        }
+
+        uint64_t GetIdleUs() const
+        {
+            return iIdleUs;
+        }
+
+        /**
+         * Returns share of time outside jobs since the first Run(), per mille
+        */
+        uint16_t GetIdlePermille() const;
+
+        /**
+         * Returns the longest lateness of all jobs
+        */
+        uint32_t GetMaxLatenessUs() const;
+};
+
+#endif /* __COOP_SCHEDULER_H__ */
@@ -0,0 +1,177 @@
+#ifndef __CRC8_H__
+#define __CRC8_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * CRC-8 engines without reflection and final XOR, generated at compile time
+ *
+ * Three variants trade memory for speed: Crc8Bitwise needs no table and
+ * shifts eight times per byte, Crc8Nibble looks up a 16 byte table twice per
+ * byte and Crc8Table looks up a 256 byte table once per byte. All of them
+ * compute the same CRC and their Update() is constexpr.
+ *
+ * @tparam POLY generator polynomial without the x^8 term
+ * @tparam INIT initial value of the CRC register
+ */
+
+/**
+ * Compile-time sequence of table indexes, std::index_sequence is not in C++11
+ */
+template<size_t... I>
+struct Crc8Indexes
+{
+};
+
+template<size_t N, size_t... I>
+struct Crc8MakeIndexes : Crc8MakeIndexes<N - 1, N - 1, I...>
+{
+};
+
+template<size_t... I>
+struct Crc8MakeIndexes<0, I...>
+{
+    typedef Crc8Indexes<I...> Type;
+};
+
+/**
+ * Operations shared by all variants, CRTP base of a variant providing Update()
+ */
+template<typename Engine, uint8_t INIT>
+class Crc8Base
+{
+    public:
+        /**
+         * Computes CRC of a message
+         *
+         * @param aData message
+         * @param aSize number of bytes in message
+         * @return computed CRC
+        */
+        static uint8_t Compute( const uint8_t *aData, const size_t aSize )
+        {
+            uint8_t crc = INIT;
+
+            for ( size_t byte = 0; byte < aSize; ++byte )
+            {
+                crc = Engine::Update( crc, aData[byte] );
+            }
+
+            return crc;
+        }
+
+        /**
+         * Validates words of a frame in one pass, each word is two data bytes
+         * followed by their CRC
+         *
+         * CRC of data followed by its own CRC is zero, so a word is valid when
+         * the register is zero after its third byte.
+         *
+         * @param aFrame frame of 3-byte words
+         * @param aWords number of words, at most 8
+         * @return bit N set if word N is valid
+        */
+        static uint8_t ValidateWords( const uint8_t *aFrame, const uint8_t aWords )
+        {
+            uint8_t valid = 0;
+
+            for ( uint8_t word = 0; word < aWords; ++word )
+            {
+                const uint8_t *bytes = &aFrame[word * 3];
+                const uint8_t crc = Engine::Update( Engine::Update( Engine::Update( INIT, bytes[0] ), bytes[1] ), bytes[2] );
+
+                valid |= ( crc == 0 ) << word;
+            }
+
+            return valid;
+        }
+};
+
+template<uint8_t POLY, uint8_t INIT>
+class Crc8Bitwise : public Crc8Base<Crc8Bitwise<POLY, INIT>, INIT>
+{
+    public:
+        /**
+         * Shifts bits out of the CRC register
+         *
+         * @param aCrc CRC register
+         * @param aBits number of bits to shift
+         * @return CRC register after shifting
+        */
+        static constexpr uint8_t Shift( const uint8_t aCrc, const uint8_t aBits )
+        {
+            return ( aBits == 0 ) ? aCrc :
+                   Shift( ( aCrc & 0x80 ) ? (uint8_t)( ( aCrc << 1 ) ^ POLY ) : (uint8_t)( aCrc << 1 ), aBits - 1 );
+        }
+
+        static constexpr uint8_t Update( const uint8_t aCrc, const uint8_t aByte )
+        {
+            return Shift( aCrc ^ aByte, 8 );
+        }
+
+        static constexpr size_t GetTableSize()
+        {
+            return 0;
+        }
+};
+
+template<uint8_t POLY, uint8_t INIT, typename = typename Crc8MakeIndexes<16>::Type>
+class Crc8Nibble;
+
+template<uint8_t POLY, uint8_t INIT, size_t... I>
+class Crc8Nibble<POLY, INIT, Crc8Indexes<I...>> : public Crc8Base<Crc8Nibble<POLY, INIT>, INIT>
+{
+    /**
+     * CRC register after shifting out a nibble, indexed by the nibble
+    */
+    static constexpr uint8_t iTable[16] = { Crc8Bitwise<POLY, INIT>::Shift( I << 4, 4 )... };
+
+    static constexpr uint8_t ShiftNibble( const uint8_t aCrc )
+    {
+        return (uint8_t)( aCrc << 4 ) ^ iTable[aCrc >> 4];
+    }
+
+    public:
+        static constexpr uint8_t Update( const uint8_t aCrc, const uint8_t aByte )
+        {
+            return ShiftNibble( ShiftNibble( aCrc ^ aByte ) );
+        }
+
+        static constexpr size_t GetTableSize()
+        {
+            return sizeof iTable;
+        }
+};
+
+template<uint8_t POLY, uint8_t INIT, size_t... I>
+constexpr uint8_t Crc8Nibble<POLY, INIT, Crc8Indexes<I...>>::iTable[16];
+
+template<uint8_t POLY, uint8_t INIT, typename = typename Crc8MakeIndexes<256>::Type>
+class Crc8Table;
+
+template<uint8_t POLY, uint8_t INIT, size_t... I>
+class Crc8Table<POLY, INIT, Crc8Indexes<I...>> : public Crc8Base<Crc8Table<POLY, INIT>, INIT>
+{
+    /**
+     * CRC register after shifting out a byte, indexed by the byte
+    */
+    static constexpr uint8_t iTable[256] = { Crc8Bitwise<POLY, INIT>::Shift( I, 8 )... };
+
+    public:
+        static constexpr uint8_t Update( const uint8_t aCrc, const uint8_t aByte )
+        {
+            return iTable[aCrc ^ aByte];
+        }
+
+        static constexpr size_t GetTableSize()
+        {
+            return sizeof iTable;
+        }
+};
+
+template<uint8_t POLY, uint8_t INIT, size_t... I>
+constexpr uint8_t Crc8Table<POLY, INIT, Crc8Indexes<I...>>::iTable[256];
+
+#endif /* __CRC8_H__ */
@@ -0,0 +1,48 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <Arduino.h>
+#include <esp_sleep.h>
+#include "DeepSleepCycle.h"
+
+RTC_DATA_ATTR SleepStats DeepSleepCycle::iStats;
+
+void DeepSleepCycle::Begin()
+{
+    switch ( esp_sleep_get_wakeup_cause() )
+    {
+    case ESP_SLEEP_WAKEUP_TIMER:
+        iCause = eWakeTimer;
+        break;
+    case ESP_SLEEP_WAKEUP_EXT0:
+        iCause = eWakeMotion;
+        iStats.iMotionWakes++;
+        break;
+    default:
+        iCause = eWakePowerOn;
+        break;
+    }
+
+    iStats.iCycles++;
+}
+
+const char* DeepSleepCycle::GetWakeCauseName( const WakeCause aCause )
+{
+    static const char *names[] = { "power", "timer", "motion" };
+
+    return names[aCause];
+}
+
+void DeepSleepCycle::Sleep( const bool aSucceeded )
+{
+    iStats.iFailedCycles += !aSucceeded;
+    iStats.iLastAwakeMs = GetAwakeMs();
+
+    esp_sleep_enable_timer_wakeup( (uint64_t) iIntervalS * 1000000 );
+
+    if ( !digitalRead( iWakePin ) )
+    {
+        esp_sleep_enable_ext0_wakeup( (gpio_num_t) iWakePin, 1 );
+    }
+
+    esp_deep_sleep_start();
+}
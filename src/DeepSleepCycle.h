@@ -0,0 +1,99 @@
+#ifndef __DEEP_SLEEP_CYCLE_H__
+#define __DEEP_SLEEP_CYCLE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <Arduino.h>
+
+/**
+ * Counters of the duty cycle, kept in RTC memory over deep sleep and cleared
+ * at power-on
+ */
+struct SleepStats
+{
+    uint32_t iCycles;
+    uint32_t iMotionWakes;
+
+    /**
+     * Cycles which failed their job, e.g. to publish
+    */
+    uint32_t iFailedCycles;
+
+    /**
+     * Time from boot to deep sleep of the previous cycle
+    */
+    uint32_t iLastAwakeMs;
+};
+
+/**
+ * Enum representing what started the current cycle
+ */
+enum WakeCause : uint8_t
+{
+    eWakePowerOn,
+    eWakeTimer,
+    eWakeMotion
+};
+
+/**
+ * Duty cycle of a battery powered device: wake up, do one job and go back to
+ * deep sleep until a timer or a motion sensor wakes the chip again
+ */
+class DeepSleepCycle
+{
+    static SleepStats iStats;
+
+    uint32_t iIntervalS;
+
+    /**
+     * RTC capable GPIO waking the chip on high level
+    */
+    uint8_t iWakePin;
+
+    WakeCause iCause;
+
+    public:
+        DeepSleepCycle( const uint32_t aIntervalS, const uint8_t aWakePin ):
+            iIntervalS( aIntervalS ),
+            iWakePin( aWakePin ),
+            iCause( eWakePowerOn )
+        {
+        }
+
+        /**
+         * Finds out the wake cause and counts the cycle, call first thing after boot
+        */
+        void Begin();
+
+        WakeCause GetWakeCause() const
+        {
+            return iCause;
+        }
+
+        static const char* GetWakeCauseName( const WakeCause aCause );
+
+        const SleepStats& GetStats() const
+        {
+            return iStats;
+        }
+
+        /**
+         * Returns time since boot, the awake window of the current cycle
+        */
+        uint32_t GetAwakeMs() const
+        {
+            return millis();
+        }
+
+        /**
+         * Arms wake-up sources and enters deep sleep, never returns
+         *
+         * Motion wakes the chip only if the sensor is idle now, otherwise a high
+         * level would wake it right away; the ongoing motion is already reported.
+         *
+         * @param aSucceeded false if the cycle failed its job
+        */
+        void Sleep( const bool aSucceeded );
+};
+
+#endif /* __DEEP_SLEEP_CYCLE_H__ */
@@ -25,6 +25,9 @@
 
 #include "ESP32httpUpdate.h"
 #include <StreamString.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <new>
 
 ESP32HTTPUpdate::ESP32HTTPUpdate(void)
 {
@@ -150,6 +153,16 @@ String ESP32HTTPUpdate::getLastErrorString(void)
         return F("Verify bin header failed");
     case HTTP_UE_BIN_FOR_WRONG_FLASH:
         return F("bin for wrong flash size");
+    case HTTP_UE_RESUME_FAILED:
+        return F("Server did not resume download");
+    case HTTP_UE_STREAM_LOST:
+        return F("Download stream lost");
+    case HTTP_UE_NO_MEMORY:
+        return F("No memory for download buffers");
+    case HTTP_UE_BAD_ENCODING:
+        return F("Unsupported image encoding");
+    case HTTP_UE_DECODE_FAILED:
+        return F("Compressed image corrupt");
     }
 
     return String();
@@ -167,37 +180,36 @@ HTTPUpdateResult ESP32HTTPUpdate::handleUpdate(HTTPClient& http, const String& c
 
     HTTPUpdateResult ret = HTTP_UPDATE_FAILED;
 
-    // use HTTP/1.0 for update since the update handler not support any transfer Encoding
-    http.useHTTP10(true);
-    http.setTimeout(30000); // allow time to download on slower networks
-    http.setUserAgent(F("ESP32-http-Update"));
-    http.addHeader(F("x-ESP32-STA-MAC"), WiFi.macAddress());
-    http.addHeader(F("x-ESP32-AP-MAC"), WiFi.softAPmacAddress());
-    // http.addHeader(F("x-ESP32-free-space"), String(ESP.getFreeSketchSpace()));
-    // http.addHeader(F("x-ESP32-sketch-size"), String(ESP.getSketchSize()));
-    // http.addHeader(F("x-ESP32-sketch-md5"), String(ESP.getSketchMD5()));
-    // http.addHeader(F("x-ESP32-chip-size"), String(ESP.getFlashChipRealSize()));
-    http.addHeader(F("x-ESP32-sdk-version"), ESP.getSdkVersion());
-
-    if(spiffs) {
-        http.addHeader(F("x-ESP32-mode"), F("spiffs"));
-    } else {
-        http.addHeader(F("x-ESP32-mode"), F("sketch"));
-    }
-
-    if(currentVersion && currentVersion[0] != 0x00) {
-        http.addHeader(F("x-ESP32-version"), currentVersion);
-    }
-
-    const char * headerkeys[] = { "x-MD5" };
-    size_t headerkeyssize = sizeof(headerkeys) / sizeof(char*);
-
-    // track these headers
-    http.collectHeaders(headerkeys, headerkeyssize);
-
+    // an image kept from an interrupted attempt continues where it stopped
+    uint32_t offset = getResumeOffset();
 
-    int code = http.GET();
+    int code = sendRequest(http, currentVersion, spiffs, offset);
     int len = http.getSize();
+    bool compressed = false;
+    uint32_t imageSize = 0;
+    bool supported = readEncoding(http, compressed, imageSize);
+
+    if(offset) {
+        if(code == HTTP_CODE_PARTIAL_CONTENT && supported && compressed == _sessionCompressed &&
+           _sessionMd5 == http.header("x-MD5") && checkRange(http, offset, _sessionSize)) {
+            DEBUG_HTTP_UPDATE("[httpUpdate] resuming at %u of %u\n", offset, _sessionSize);
+            code = HTTP_CODE_OK;
+            len = _sessionSize;
+            imageSize = _sessionImageSize;
+        } else if(code > 0) {
+            // another image or no Range support, start over
+            DEBUG_HTTP_UPDATE("[httpUpdate] resume refused (%d), starting over\n", code);
+            abortSession();
+            offset = 0;
+
+            if(code != HTTP_CODE_OK) {
+                http.end();
+                code = sendRequest(http, currentVersion, spiffs, 0);
+                len = http.getSize();
+                supported = readEncoding(http, compressed, imageSize);
+            }
+        }
+    }
 
     if(code <= 0) {
         DEBUG_HTTP_UPDATE("[httpUpdate] HTTP error: %s\n", http.errorToString(code).c_str());
@@ -220,14 +232,24 @@ HTTPUpdateResult ESP32HTTPUpdate::handleUpdate(HTTPClient& http, const String& c
         DEBUG_HTTP_UPDATE("[httpUpdate]  - current version: %s\n", currentVersion.c_str() );
     }
 
+    if(compressed) {
+        DEBUG_HTTP_UPDATE("[httpUpdate]  - compressed, image size: %u\n", imageSize);
+    } else if(len > 0) {
+        imageSize = len;
+    }
+
     switch(code) {
     case HTTP_CODE_OK:  ///< OK (Start Update)
-        if(len > 0) {
+        if(!supported) {
+            _lastError = HTTP_UE_BAD_ENCODING;
+            ret = HTTP_UPDATE_FAILED;
+            DEBUG_HTTP_UPDATE("[httpUpdate] unsupported encoding: %s\n", http.header("x-Encoding").c_str());
+        } else if(len > 0 && imageSize > 0) {
             bool startUpdate = true;
             if(spiffs) {
                 size_t spiffsSize = ((size_t) SPIFFS.totalBytes() - (size_t) SPIFFS.usedBytes());
-                if(len > (int) spiffsSize) {
-                    DEBUG_HTTP_UPDATE("[httpUpdate] spiffsSize to low (%d) needed: %d\n", spiffsSize, len);
+                if(imageSize > spiffsSize) {
+                    DEBUG_HTTP_UPDATE("[httpUpdate] spiffsSize to low (%d) needed: %d\n", spiffsSize, imageSize);
                     startUpdate = false;
                 }
             } else {
@@ -242,8 +264,6 @@ HTTPUpdateResult ESP32HTTPUpdate::handleUpdate(HTTPClient& http, const String& c
                 ret = HTTP_UPDATE_FAILED;
             } else {
 
-                WiFiClient * tcp = http.getStreamPtr();
-
                 //WiFiUDP::stopAll();
                 //WiFiClient::stopAllExcept(tcp);
 
@@ -259,7 +279,7 @@ HTTPUpdateResult ESP32HTTPUpdate::handleUpdate(HTTPClient& http, const String& c
                     DEBUG_HTTP_UPDATE("[httpUpdate] runUpdate flash...\n");
                 }
 
-                if(!spiffs) {
+                if(!spiffs && !offset) {
 
                     /*
                     uint8_t buf[4];
@@ -293,7 +313,7 @@ HTTPUpdateResult ESP32HTTPUpdate::handleUpdate(HTTPClient& http, const String& c
                     */
                 }
 
-                if(runUpdate(*tcp, len, http.header("x-MD5"), command)) {
+                if(runUpdate(http, currentVersion, spiffs, offset, len, imageSize, compressed, http.header("x-MD5"), command)) {
                     ret = HTTP_UPDATE_OK;
                     DEBUG_HTTP_UPDATE("[httpUpdate] Update ok\n");
                     http.end();
@@ -337,47 +357,486 @@ HTTPUpdateResult ESP32HTTPUpdate::handleUpdate(HTTPClient& http, const String& c
     return ret;
 }
 
+/**
+ * send the update request
+ * @param http HTTPClient &
+ * @param currentVersion const String &
+ * @param spiffs bool
+ * @param offset uint32_t first byte to download, Range request if not zero
+ * @return int HTTP code
+ */
+int ESP32HTTPUpdate::sendRequest(HTTPClient& http, const String& currentVersion, bool spiffs, uint32_t offset)
+{
+    // use HTTP/1.0 for update since the update handler not support any transfer Encoding
+    http.useHTTP10(true);
+    http.setTimeout(30000); // allow time to download on slower networks
+    http.setUserAgent(F("ESP32-http-Update"));
+    http.addHeader(F("x-ESP32-STA-MAC"), WiFi.macAddress());
+    http.addHeader(F("x-ESP32-AP-MAC"), WiFi.softAPmacAddress());
+    // http.addHeader(F("x-ESP32-free-space"), String(ESP.getFreeSketchSpace()));
+    // http.addHeader(F("x-ESP32-sketch-size"), String(ESP.getSketchSize()));
+    // http.addHeader(F("x-ESP32-sketch-md5"), String(ESP.getSketchMD5()));
+    // http.addHeader(F("x-ESP32-chip-size"), String(ESP.getFlashChipRealSize()));
+    http.addHeader(F("x-ESP32-sdk-version"), ESP.getSdkVersion());
+
+    if(spiffs) {
+        http.addHeader(F("x-ESP32-mode"), F("spiffs"));
+    } else {
+        http.addHeader(F("x-ESP32-mode"), F("sketch"));
+    }
+
+    if(currentVersion && currentVersion[0] != 0x00) {
+        http.addHeader(F("x-ESP32-version"), currentVersion);
+    }
+
+    if(offset) {
+        char range[24];
+        snprintf(range, sizeof(range), "bytes=%u-", (unsigned) offset);
+        http.addHeader(F("Range"), range);
+    }
+
+    // the server may answer with a compressed image in this format
+    char encoding[32];
+    snprintf(encoding, sizeof(encoding), HTTP_UPDATE_HEATSHRINK, HEATSHRINK_WINDOW_BITS, HEATSHRINK_LOOKAHEAD_BITS);
+    http.addHeader(F("x-ESP32-accept-encoding"), encoding);
+
+    const char * headerkeys[] = { "x-MD5", "Content-Range", "x-Encoding", "x-Image-Size" };
+    size_t headerkeyssize = sizeof(headerkeys) / sizeof(char*);
+
+    // track these headers
+    http.collectHeaders(headerkeys, headerkeyssize);
+
+    return http.GET();
+}
+
+/**
+ * check a partial response continues the image at offset
+ * @param http HTTPClient &
+ * @param offset uint32_t
+ * @param size uint32_t size of the whole image
+ * @return true if Content-Range matches
+ */
+bool ESP32HTTPUpdate::checkRange(HTTPClient& http, uint32_t offset, uint32_t size)
+{
+    unsigned first = 0;
+    unsigned last = 0;
+    unsigned total = 0;
+
+    if(sscanf(http.header("Content-Range").c_str(), "bytes %u-%u/%u", &first, &last, &total) != 3) {
+        return false;
+    }
+
+    return first == offset && total == size && last + 1 == size;
+}
+
+/**
+ * read the encoding of the image in the response
+ * @param http HTTPClient &
+ * @param compressed bool & true for a heatshrink stream
+ * @param imageSize uint32_t & size of the decompressed image, 0 if not reported
+ * @return false if the encoding is not supported
+ */
+bool ESP32HTTPUpdate::readEncoding(HTTPClient& http, bool& compressed, uint32_t& imageSize)
+{
+    compressed = false;
+    imageSize = 0;
+
+    String encoding = http.header("x-Encoding");
+    if(!encoding.length()) {
+        return true;
+    }
+
+    char supported[32];
+    snprintf(supported, sizeof(supported), HTTP_UPDATE_HEATSHRINK, HEATSHRINK_WINDOW_BITS, HEATSHRINK_LOOKAHEAD_BITS);
+    if(strcmp(encoding.c_str(), supported) != 0) {
+        return false;
+    }
+
+    compressed = true;
+    imageSize = http.header("x-Image-Size").toInt();
+    return true;
+}
+
+/**
+ * offset of the kept update session
+ * @return uint32_t bytes already written, 0 if there is no session
+ */
+uint32_t ESP32HTTPUpdate::getResumeOffset(void)
+{
+    if(!_sessionSize) {
+        return 0;
+    }
+
+    if(!Update.isRunning()) {
+        _sessionSize = 0;
+        return 0;
+    }
+
+    return _flashed;
+}
+
+/**
+ * drop the kept update session
+ */
+void ESP32HTTPUpdate::abortSession(void)
+{
+    if(Update.isRunning()) {
+        Update.abort();
+    }
+
+    delete _decoder;
+    _decoder = nullptr;
+
+    _sessionSize = 0;
+    _sessionMd5 = String();
+    _sessionCompressed = false;
+    _flashed = 0;
+    _imageWritten = 0;
+}
+
+/**
+ * write chunks coming from the download to flash
+ * @param update ESP32HTTPUpdate *
+ */
+void ESP32HTTPUpdate::writerTask(void* update)
+{
+    ESP32HTTPUpdate * self = static_cast<ESP32HTTPUpdate *>(update);
+    HTTPUpdateChunk chunk;
+
+    for(;;) {
+        if(!self->_fullChunks.Pop(chunk)) {
+            vTaskDelay(1);
+            continue;
+        }
+
+        if(chunk.index == HTTP_UPDATE_STOP) {
+            break;
+        }
+
+        // after an error the buffers only go back, so the download never waits forever
+        if(!self->_writerFailed && chunk.length) {
+            uint8_t * data = &self->_chunks[chunk.index * HTTP_UPDATE_CHUNK_SIZE];
+
+            if(self->_decoder) {
+                self->writeDecoded(data, chunk.length);
+            } else if(Update.write(data, chunk.length) == chunk.length) {
+                self->_imageWritten += chunk.length;
+            } else {
+                self->_writerFailed = true;
+            }
+
+            if(!self->_writerFailed) {
+                self->_flashed += chunk.length;
+            }
+        }
+
+        self->_freeChunks.Push(chunk);
+    }
+
+    self->_writerDone = true;
+    vTaskDelete(nullptr);
+}
+
+/**
+ * decompress a chunk and write it to flash, the decoder keeps a symbol split
+ * between chunks for the next one
+ * @param data uint8_t * compressed bytes
+ * @param length uint16_t
+ */
+void ESP32HTTPUpdate::writeDecoded(uint8_t* data, uint16_t length)
+{
+    uint8_t out[HTTP_UPDATE_DECODE_SIZE];
+    size_t used = 0;
+    size_t produced;
+
+    // a full output buffer may leave input and a pending copy for the next round
+    do {
+        size_t consumed;
+        produced = _decoder->Decode(&data[used], length - used, consumed, out, sizeof(out));
+        used += consumed;
+
+        if(_decoder->IsFailed() || _decoder->GetTotal() > _sessionImageSize) {
+            _writerError = HTTP_UE_DECODE_FAILED;
+            _writerFailed = true;
+            return;
+        }
+
+        if(produced && Update.write(out, produced) != produced) {
+            _writerFailed = true;
+            return;
+        }
+
+        _imageWritten += produced;
+    } while(produced == sizeof(out));
+}
+
+/**
+ * download the rest of the image into the pipeline, resume lost streams
+ * @param http HTTPClient & with the response stream positioned at _stats.received
+ * @param currentVersion const String &
+ * @param spiffs bool
+ * @param size uint32_t size of the whole image
+ * @return true if the whole image was downloaded
+ */
+bool ESP32HTTPUpdate::download(HTTPClient& http, const String& currentVersion, bool spiffs, uint32_t size)
+{
+    const uint32_t start = millis();
+    const uint32_t startOffset = _stats.received;
+    uint32_t lastData = start;
+    HTTPUpdateChunk chunk = { 0, 0 };
+    bool haveChunk = false;
+    bool complete = false;
+
+    while(!_writerFailed) {
+        if(_stats.received == size) {
+            complete = true;
+            break;
+        }
+
+        if(!haveChunk) {
+            // both buffers are queued, the download is faster than flash
+            const uint32_t wait = millis();
+            while(!_freeChunks.Pop(chunk)) {
+                vTaskDelay(1);
+            }
+            _stats.flashWaitMs += millis() - wait;
+            chunk.length = 0;
+            haveChunk = true;
+        }
+
+        WiFiClient * tcp = http.getStreamPtr();
+        size_t available = tcp ? tcp->available() : 0;
+
+        if(available) {
+            size_t space = HTTP_UPDATE_CHUNK_SIZE - chunk.length;
+            if(space > size - _stats.received) {
+                space = size - _stats.received;
+            }
+            if(available > space) {
+                available = space;
+            }
+
+            int got = tcp->read(&_chunks[chunk.index * HTTP_UPDATE_CHUNK_SIZE + chunk.length], available);
+            if(got > 0) {
+                chunk.length += got;
+                _stats.received += got;
+                lastData = millis();
+            }
+
+            if(chunk.length == HTTP_UPDATE_CHUNK_SIZE || _stats.received == size) {
+                _fullChunks.Push(chunk);
+                haveChunk = false;
+
+                _stats.written = _flashed;
+                _stats.image = _imageWritten;
+                _stats.elapsedMs = millis() - start;
+                _stats.bytesPerSecond = _stats.elapsedMs ? (uint64_t) (_stats.received - startOffset) * 1000 / _stats.elapsedMs : 0;
+
+                if(_progressCallback) {
+                    _progressCallback(_stats);
+                }
+
+                // a sustained stream never reaches the stall branch, let the idle task of this core run
+                vTaskDelay(1);
+            }
+            continue;
+        }
+
+        if(tcp && tcp->connected() && millis() - lastData < HTTP_UPDATE_STALL_MS) {
+            delay(1);
+            continue;
+        }
+
+        // the resumed stream continues right after the bytes already received
+        if(haveChunk) {
+            _fullChunks.Push(chunk);
+            haveChunk = false;
+        }
+
+        if(_stats.resumes >= HTTP_UPDATE_MAX_RESUMES) {
+            _lastError = HTTP_UE_STREAM_LOST;
+            break;
+        }
+
+        _stats.resumes++;
+        DEBUG_HTTP_UPDATE("[httpUpdate] stream lost at %u, resuming\n", _stats.received);
+
+        http.end();
+        int code = sendRequest(http, currentVersion, spiffs, _stats.received);
+        if(code != HTTP_CODE_PARTIAL_CONTENT || !checkRange(http, _stats.received, size)) {
+            DEBUG_HTTP_UPDATE("[httpUpdate] resume failed (%d)\n", code);
+            _lastError = (code <= 0) ? HTTP_UE_STREAM_LOST : HTTP_UE_RESUME_FAILED;
+            break;
+        }
+        lastData = millis();
+    }
+
+    if(haveChunk) {
+        _fullChunks.Push(chunk);
+    }
+
+    _stats.elapsedMs = millis() - start;
+    return complete;
+}
+
 /**
  * write Update to flash
- * @param in Stream&
- * @param size uint32_t
- * @param md5 String
+ *
+ * The image is downloaded into one buffer while a writer task writes the other
+ * one to flash. A lost stream is resumed with a Range request; if that fails
+ * too, the update session is kept so the next attempt continues from the bytes
+ * already written.
+ *
+ * @param http HTTPClient & with the response stream at offset
+ * @param currentVersion const String &
+ * @param spiffs bool
+ * @param offset uint32_t bytes written by the kept session, 0 to begin a new one
+ * @param size uint32_t size of the whole download
+ * @param imageSize uint32_t size of the image in flash, differs from size if compressed
+ * @param compressed bool heatshrink stream, decompressed by the writer task
+ * @param md5 String of the image in flash
  * @return true if Update ok
  */
-bool ESP32HTTPUpdate::runUpdate(Stream& in, uint32_t size, String md5, int command)
+bool ESP32HTTPUpdate::runUpdate(HTTPClient& http, const String& currentVersion, bool spiffs, uint32_t offset,
+                                uint32_t size, uint32_t imageSize, bool compressed, String md5, int command)
 {
 
     StreamString error;
 
-    if(!Update.begin(size, command)) {
-        _lastError = Update.getError();
-        Update.printError(error);
-        error.trim(); // remove line ending
-        DEBUG_HTTP_UPDATE("[httpUpdate] Update.begin failed! (%s)\n", error.c_str());
+    if(!offset) {
+        if(compressed) {
+            _decoder = new (std::nothrow) HeatshrinkDecoder();
+            if(!_decoder) {
+                _lastError = HTTP_UE_NO_MEMORY;
+                return false;
+            }
+        }
+
+        // size and MD5 are checked by Update on the decompressed image
+        if(!Update.begin(imageSize, command)) {
+            _lastError = Update.getError();
+            Update.printError(error);
+            error.trim(); // remove line ending
+            DEBUG_HTTP_UPDATE("[httpUpdate] Update.begin failed! (%s)\n", error.c_str());
+            abortSession();
+            return false;
+        }
+
+        if(md5.length()) {
+            if(!Update.setMD5(md5.c_str())) {
+                _lastError = HTTP_UE_SERVER_FAULTY_MD5;
+                DEBUG_HTTP_UPDATE("[httpUpdate] Update.setMD5 failed! (%s)\n", md5.c_str());
+                abortSession();
+                return false;
+            }
+        }
+
+        _sessionSize = size;
+        _sessionImageSize = imageSize;
+        _sessionMd5 = md5;
+        _sessionCompressed = compressed;
+        _flashed = 0;
+        _imageWritten = 0;
+    }
+
+    _stats = HTTPUpdateStats();
+    _stats.total = size;
+    _stats.received = offset;
+    _stats.written = offset;
+    _stats.image = _imageWritten;
+
+    _chunks = (uint8_t *) malloc(HTTP_UPDATE_CHUNKS * HTTP_UPDATE_CHUNK_SIZE);
+    if(!_chunks) {
+        _lastError = HTTP_UE_NO_MEMORY;
+        abortSession();
         return false;
     }
 
-    if(md5.length()) {
-        if(!Update.setMD5(md5.c_str())) {
-            _lastError = HTTP_UE_SERVER_FAULTY_MD5;
-            DEBUG_HTTP_UPDATE("[httpUpdate] Update.setMD5 failed! (%s)\n", md5.c_str());
-            return false;
+    for(uint8_t idx = 0; idx < HTTP_UPDATE_CHUNKS; ++idx) {
+        HTTPUpdateChunk chunk = { idx, 0 };
+        _freeChunks.Push(chunk);
+    }
+
+    _writerError = 0;
+    _writerFailed = false;
+    _writerDone = false;
+
+    if(xTaskCreatePinnedToCore(writerTask, "ota_writer", HTTP_UPDATE_WRITER_STACK, this,
+                               HTTP_UPDATE_WRITER_PRIORITY, nullptr, tskNO_AFFINITY) != pdPASS) {
+        _writerDone = true;
+        _lastError = HTTP_UE_NO_MEMORY;
+    }
+
+    bool complete = !_writerDone && download(http, currentVersion, spiffs, size);
+
+    if(!_writerDone) {
+        const HTTPUpdateChunk stop = { HTTP_UPDATE_STOP, 0 };
+        while(!_fullChunks.Push(stop)) {
+            vTaskDelay(1);
+        }
+        while(!_writerDone) {
+            vTaskDelay(1);
         }
     }
 
-    if(Update.writeStream(in) != size) {
+    // the queues are left empty for the next update
+    HTTPUpdateChunk chunk;
+    while(_freeChunks.Pop(chunk)) {
+    }
+    while(_fullChunks.Pop(chunk)) {
+    }
+    free(_chunks);
+    _chunks = nullptr;
+
+    _stats.written = _flashed;
+    _stats.image = _imageWritten;
+
+    DEBUG_HTTP_UPDATE("[httpUpdate] %u of %u bytes in %u ms, %u B/s, %u resumes, %u ms waiting for flash\n",
+                      _stats.written, size, _stats.elapsedMs, _stats.bytesPerSecond, _stats.resumes, _stats.flashWaitMs);
+
+    if(_writerFailed && _writerError) {
+        _lastError = _writerError;
+        DEBUG_HTTP_UPDATE("[httpUpdate] decoding failed at %u\n", _flashed);
+        abortSession();
+        return false;
+    }
+
+    if(_writerFailed) {
         _lastError = Update.getError();
         Update.printError(error);
         error.trim(); // remove line ending
-        DEBUG_HTTP_UPDATE("[httpUpdate] Update.writeStream failed! (%s)\n", error.c_str());
+        DEBUG_HTTP_UPDATE("[httpUpdate] Update.write failed! (%s)\n", error.c_str());
+        abortSession();
         return false;
     }
 
+    if(!complete) {
+        // without MD5 the next attempt cannot tell it downloads the same image
+        if(!_sessionMd5.length() || _lastError == HTTP_UE_NO_MEMORY) {
+            abortSession();
+        }
+        return false;
+    }
+
+    // a stream ending early decodes fine, only its size tells
+    if(_imageWritten != _sessionImageSize) {
+        _lastError = HTTP_UE_DECODE_FAILED;
+        DEBUG_HTTP_UPDATE("[httpUpdate] image is %u bytes, expected %u\n", _imageWritten, _sessionImageSize);
+        abortSession();
+        return false;
+    }
+
+    delete _decoder;
+    _decoder = nullptr;
+    _sessionSize = 0;
+    _sessionMd5 = String();
+
     if(!Update.end()) {
         _lastError = Update.getError();
         Update.printError(error);
         error.trim(); // remove line ending
         DEBUG_HTTP_UPDATE("[httpUpdate] Update.end failed! (%s)\n", error.c_str());
+        abortSession();
         return false;
     }
 
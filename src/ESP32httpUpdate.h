@@ -35,6 +35,8 @@
 
 #include "FS.h"
 #include "SPIFFS.h"
+#include "SpscQueue.h"
+#include "HeatshrinkDecoder.h"
 
 #ifdef DEBUG_ESP_HTTP_UPDATE
 #ifdef DEBUG_ESP_PORT
@@ -55,6 +57,27 @@
 #define HTTP_UE_SERVER_FAULTY_MD5           (-105)
 #define HTTP_UE_BIN_VERIFY_HEADER_FAILED    (-106)
 #define HTTP_UE_BIN_FOR_WRONG_FLASH         (-107)
+#define HTTP_UE_RESUME_FAILED               (-108)
+#define HTTP_UE_STREAM_LOST                 (-109)
+#define HTTP_UE_NO_MEMORY                   (-110)
+#define HTTP_UE_BAD_ENCODING                (-111)
+#define HTTP_UE_DECODE_FAILED               (-112)
+
+/// the image is downloaded into one buffer while the other one is written to flash
+#define HTTP_UPDATE_CHUNK_SIZE              4096
+#define HTTP_UPDATE_CHUNKS                  2
+/// interrupted downloads continue with a Range request this many times per attempt
+#define HTTP_UPDATE_MAX_RESUMES             8
+/// stream without data for this long is treated as lost
+#define HTTP_UPDATE_STALL_MS                10000
+#define HTTP_UPDATE_WRITER_STACK            4096
+#define HTTP_UPDATE_WRITER_PRIORITY         2
+/// index of the chunk which stops the flash writer
+#define HTTP_UPDATE_STOP                    0xFF
+/// compressed images are announced in x-Encoding with the decompressed size in x-Image-Size,
+/// the writer task decodes them into a buffer of HTTP_UPDATE_DECODE_SIZE bytes
+#define HTTP_UPDATE_HEATSHRINK              "heatshrink;w=%u;l=%u"
+#define HTTP_UPDATE_DECODE_SIZE             512
 
 enum HTTPUpdateResult {
     HTTP_UPDATE_FAILED,
@@ -64,6 +87,25 @@ enum HTTPUpdateResult {
 
 typedef HTTPUpdateResult t_httpUpdate_return; // backward compatibility
 
+struct HTTPUpdateStats {
+    uint32_t total;         ///< size of the image
+    uint32_t received;      ///< bytes downloaded, including those of resumed attempts
+    uint32_t written;       ///< bytes accepted by the flash writer
+    uint32_t image;         ///< bytes written to flash, decompressed
+    uint32_t resumes;       ///< Range requests after a lost stream in this attempt
+    uint32_t elapsedMs;     ///< duration of this attempt
+    uint32_t bytesPerSecond;///< download throughput of this attempt
+    uint32_t flashWaitMs;   ///< time the download waited for a free buffer
+};
+
+typedef void (*HTTPUpdateProgressCB)(const HTTPUpdateStats& stats);
+
+/// buffer passed between the download and the flash writer
+struct HTTPUpdateChunk {
+    uint8_t index;
+    uint16_t length;
+};
+
 class ESP32HTTPUpdate
 {
 public:
@@ -101,12 +143,56 @@ public:
     int getLastError(void);
     String getLastErrorString(void);
 
+    /// called from the updating task after every downloaded buffer
+    void onProgress(HTTPUpdateProgressCB callback)
+    {
+        _progressCallback = callback;
+    }
+
+    const HTTPUpdateStats& getStats(void) const
+    {
+        return _stats;
+    }
+
+    /// offset the next update() resumes from, zero if no interrupted image is kept
+    uint32_t getResumeOffset(void);
+
 protected:
     t_httpUpdate_return handleUpdate(HTTPClient& http, const String& currentVersion, bool spiffs = false);
-    bool runUpdate(Stream& in, uint32_t size, String md5, int command = U_FLASH);
+    int sendRequest(HTTPClient& http, const String& currentVersion, bool spiffs, uint32_t offset);
+    bool checkRange(HTTPClient& http, uint32_t offset, uint32_t size);
+    bool readEncoding(HTTPClient& http, bool& compressed, uint32_t& imageSize);
+    bool runUpdate(HTTPClient& http, const String& currentVersion, bool spiffs, uint32_t offset,
+                   uint32_t size, uint32_t imageSize, bool compressed, String md5, int command = U_FLASH);
+    bool download(HTTPClient& http, const String& currentVersion, bool spiffs, uint32_t size);
+    void abortSession(void);
+    static void writerTask(void* update);
+    void writeDecoded(uint8_t* data, uint16_t length);
 
     int _lastError;
     bool _rebootOnUpdate = true;
+
+    HTTPUpdateProgressCB _progressCallback = nullptr;
+    HTTPUpdateStats _stats = {};
+
+    // Update session kept open after a lost download, MD5 tells the same image
+    uint32_t _sessionSize = 0;
+    uint32_t _sessionImageSize = 0;
+    String _sessionMd5;
+    bool _sessionCompressed = false;
+
+    // Decoder of a compressed image, lives as long as its session
+    HeatshrinkDecoder* _decoder = nullptr;
+
+    // Download pipeline, buffers go to the writer task over _fullChunks and back over _freeChunks
+    uint8_t* _chunks = nullptr;
+    SpscQueue<HTTPUpdateChunk, HTTP_UPDATE_CHUNKS> _freeChunks;
+    SpscQueue<HTTPUpdateChunk, HTTP_UPDATE_CHUNKS> _fullChunks;
+    volatile uint32_t _flashed = 0;
+    volatile uint32_t _imageWritten = 0;
+    volatile int _writerError = 0;
+    volatile bool _writerFailed = false;
+    volatile bool _writerDone = true;
 };
 
 #if !defined(NO_GLOBAL_INSTANCES) && !defined(NO_GLOBAL_HTTPUPDATE)
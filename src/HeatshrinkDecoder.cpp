@@ -0,0 +1,110 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "HeatshrinkDecoder.h"
+
+void HeatshrinkDecoder::Reset()
+{
+    // The encoder may not reference the window before the stream started,
+    // zeroing keeps the output defined if a corrupt stream does
+    memset( iWindow, 0, sizeof iWindow );
+    iTotal = 0;
+    iState = eTag;
+    iBits = 0;
+    iBitCount = 0;
+    iOffset = 0;
+    iCount = 0;
+}
+
+bool HeatshrinkDecoder::TakeBits( const uint8_t aCount, const uint8_t *aIn, const size_t aSize, size_t &aPos, uint16_t &aValue )
+{
+    while ( iBitCount < aCount )
+    {
+        if ( aPos == aSize )
+        {
+            return false;
+        }
+
+        iBits = ( iBits << 8 ) | aIn[aPos++];
+        iBitCount += 8;
+    }
+
+    iBitCount -= aCount;
+    aValue = ( iBits >> iBitCount ) & ( ( 1u << aCount ) - 1 );
+
+    return true;
+}
+
+size_t HeatshrinkDecoder::Decode( const uint8_t *aIn, const size_t aInSize, size_t &aConsumed,
+                                  uint8_t *aOut, const size_t aOutSize )
+{
+    size_t produced = 0;
+    uint16_t value;
+
+    aConsumed = 0;
+
+    while ( produced < aOutSize )
+    {
+        switch ( iState )
+        {
+        case eTag:
+            if ( !TakeBits( 1, aIn, aInSize, aConsumed, value ) )
+            {
+                return produced;
+            }
+
+            iState = value ? eLiteral : eIndex;
+            break;
+
+        case eLiteral:
+            if ( !TakeBits( 8, aIn, aInSize, aConsumed, value ) )
+            {
+                return produced;
+            }
+
+            Emit( value, aOut, produced );
+            iState = eTag;
+            break;
+
+        case eIndex:
+            if ( !TakeBits( HEATSHRINK_WINDOW_BITS, aIn, aInSize, aConsumed, value ) )
+            {
+                return produced;
+            }
+
+            iOffset = value + 1;
+            iState = ( iOffset > iTotal ) ? eError : eCount;
+            break;
+
+        case eCount:
+            if ( !TakeBits( HEATSHRINK_LOOKAHEAD_BITS, aIn, aInSize, aConsumed, value ) )
+            {
+                return produced;
+            }
+
+            iCount = value + 1;
+            iState = eCopy;
+            break;
+
+        case eCopy:
+            // A copy longer than the output space continues in the next call
+            while ( ( iCount != 0 ) && ( produced < aOutSize ) )
+            {
+                Emit( iWindow[( iTotal - iOffset ) & ( HEATSHRINK_WINDOW_SIZE - 1 )], aOut, produced );
+                iCount--;
+            }
+
+            if ( iCount == 0 )
+            {
+                iState = eTag;
+            }
+            break;
+
+        case eError:
+            return produced;
+        }
+    }
+
+    return produced;
+}
@@ -0,0 +1,131 @@
+#ifndef __HEATSHRINK_DECODER_H__
+#define __HEATSHRINK_DECODER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Parameters of the compressed stream, must match the encoder, e.g.
+ * heatshrink -e -w 11 -l 4 firmware.bin firmware.bin.hs
+ */
+#define HEATSHRINK_WINDOW_BITS      11
+#define HEATSHRINK_LOOKAHEAD_BITS   4
+
+/**
+ * Size of the window of past output, back-references reach that far
+ */
+#define HEATSHRINK_WINDOW_SIZE      ( 1 << HEATSHRINK_WINDOW_BITS )
+
+/**
+ * Streaming decoder of heatshrink (LZSS) compressed data
+ *
+ * The stream is a sequence of bit-packed symbols, most significant bit first:
+ *
+ *  1 + 8 bits                  literal byte
+ *  0 + W bits + L bits         back-reference: offset - 1 into the window of
+ *                              past output, then number of copied bytes - 1
+ *
+ * The last byte is padded with zero bits. Input and output may be cut at any
+ * byte, a symbol split between two calls continues in the next one, so the
+ * decoder needs no more memory than its window.
+ */
+class HeatshrinkDecoder
+{
+    /**
+     * Enum representing the next part of the stream expected by the decoder
+    */
+    enum State : uint8_t
+    {
+        eTag,
+        eLiteral,
+        eIndex,
+        eCount,
+        eCopy,
+        eError
+    };
+
+    /**
+     * Past output, iTotal & mask is the next position
+    */
+    uint8_t iWindow[HEATSHRINK_WINDOW_SIZE];
+    uint32_t iTotal;
+
+    State iState;
+
+    /**
+     * Input bits not consumed yet, iBitCount lowest bits of iBits are valid
+    */
+    uint32_t iBits;
+    uint8_t iBitCount;
+
+    /**
+     * Offset and remaining length of the back-reference being copied
+    */
+    uint16_t iOffset;
+    uint16_t iCount;
+
+    /**
+     * Takes bits from the accumulator, refills it from input
+     *
+     * @param aCount number of bits, at most 16
+     * @param aIn input
+     * @param aSize size of input
+     * @param aPos position in input, advanced by consumed bytes
+     * @param aValue taken bits
+     * @return False if input ran out, consumed bytes are kept for the next call
+    */
+    bool TakeBits( const uint8_t aCount, const uint8_t *aIn, const size_t aSize, size_t &aPos, uint16_t &aValue );
+
+    void Emit( const uint8_t aByte, uint8_t *aOut, size_t &aProduced )
+    {
+        iWindow[iTotal & ( HEATSHRINK_WINDOW_SIZE - 1 )] = aByte;
+        iTotal++;
+        aOut[aProduced++] = aByte;
+    }
+
+    public:
+        HeatshrinkDecoder()
+        {
+            Reset();
+        }
+
+        /**
+         * Prepares the decoder for a new stream
+        */
+        void Reset();
+
+        /**
+         * Decodes as much input as fits to output
+         *
+         * @param aIn compressed input
+         * @param aInSize size of input
+         * @param aConsumed number of input bytes consumed
+         * @param aOut decompressed output
+         * @param aOutSize size of output
+         * @return Number of bytes written to output, input is consumed
+         *         completely when this is less than aOutSize
+        */
+        size_t Decode( const uint8_t *aIn, const size_t aInSize, size_t &aConsumed,
+                       uint8_t *aOut, const size_t aOutSize );
+
+        /**
+         * Tells if the stream referenced data before its start, decoding stops then
+        */
+        bool IsFailed() const
+        {
+            return iState == eError;
+        }
+
+        /**
+         * Returns number of decompressed bytes since Reset(), padding of the
+         * last byte looks like a started symbol, so a stream is complete when
+         * this reaches its known size
+        */
+        uint32_t GetTotal() const
+        {
+            return iTotal;
+        }
+};
+
+#endif /* __HEATSHRINK_DECODER_H__ */
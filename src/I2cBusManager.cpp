@@ -0,0 +1,97 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <Arduino.h>
+#include <Wire.h>
+#include "I2cBusManager.h"
+
+bool I2cBusManager::Begin( const uint8_t aBus, const uint8_t aSDA, const uint8_t aSCL, const uint32_t aFrequency )
+{
+    if ( aBus >= I2C_NUM_OF_BUSES )
+    {
+        return false;
+    }
+
+    if ( !iWires[aBus].begin( aSDA, aSCL, aFrequency ) )
+    {
+        return false;
+    }
+
+    iWires[aBus].flush();
+
+    return true;
+}
+
+bool I2cBusManager::Add( I2cDriver &aDriver )
+{
+    if ( iCount >= I2C_MAX_DRIVERS )
+    {
+        return false;
+    }
+
+    iDrivers[iCount++] = &aDriver;
+
+    return true;
+}
+
+void I2cBusManager::Update()
+{
+    uint8_t served[I2C_MAX_DRIVERS] = {};
+
+    if ( iCount == 0 )
+    {
+        return;
+    }
+
+    // Each pass steps the due driver with the earliest deadline, so a result
+    // which is ready sooner is collected first and every driver steps once
+    for ( uint8_t pass = 0; pass < iCount; ++pass )
+    {
+        const uint32_t now = micros();
+        int32_t best_lateness = -1;
+        uint8_t best = 0;
+
+        for ( uint8_t idx = 0; idx < iCount; ++idx )
+        {
+            // Round-robin order starts at iNext, so ties go to the longest waiting
+            const uint8_t driver = ( iNext + idx ) % iCount;
+            const int32_t lateness = (int32_t)( now - iDrivers[driver]->GetDeadlineUs() );
+
+            if ( !served[driver] && ( lateness > best_lateness ) )
+            {
+                best_lateness = lateness;
+                best = driver;
+            }
+        }
+
+        // No driver is due
+        if ( best_lateness < 0 )
+        {
+            break;
+        }
+
+        served[best] = true;
+        iDrivers[best]->Step();
+        iSteps++;
+    }
+
+    iNext = ( iNext + 1 ) % iCount;
+}
+
+uint32_t I2cBusManager::GetDeadlineUs( const uint32_t aIdleUs ) const
+{
+    const uint32_t now = micros();
+    uint32_t earliest = now + aIdleUs;
+
+    // Compared relative to now, so deadlines stay ordered over micros() wrap-around
+    for ( uint8_t idx = 0; idx < iCount; ++idx )
+    {
+        const uint32_t deadline = iDrivers[idx]->GetDeadlineUs();
+
+        if ( (int32_t)( deadline - earliest ) < 0 )
+        {
+            earliest = deadline;
+        }
+    }
+
+    return earliest;
+}
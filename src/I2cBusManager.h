@@ -0,0 +1,121 @@
+#ifndef __I2C_BUS_MANAGER_H__
+#define __I2C_BUS_MANAGER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <Arduino.h>
+#include <Wire.h>
+
+/**
+ * Number of I2C buses of ESP32
+ */
+#define I2C_NUM_OF_BUSES        2
+
+/**
+ * Maximal number of drivers sharing the buses
+ */
+#define I2C_MAX_DRIVERS         8
+
+/**
+ * Driver of a device on a shared I2C bus
+ *
+ * A driver performs at most one short bus transaction per Step() and tells
+ * the bus manager when it needs the bus next, so conversions of several
+ * devices overlap instead of waiting for each other.
+ */
+class I2cDriver
+{
+    public:
+        virtual ~I2cDriver()
+        {
+        }
+
+        /**
+         * Performs the next step of the driver
+        */
+        virtual void Step() = 0;
+
+        /**
+         * Returns time the driver needs the bus next, micros()
+        */
+        virtual uint32_t GetDeadlineUs() const = 0;
+};
+
+class I2cBusManager
+{
+    /**
+     * Bus controllers, owned by the manager and shared by drivers
+    */
+    TwoWire iWires[I2C_NUM_OF_BUSES];
+
+    /**
+     * Registered drivers in round-robin order
+    */
+    I2cDriver* iDrivers[I2C_MAX_DRIVERS];
+    uint8_t iCount;
+
+    /**
+     * Driver served first among equal deadlines in the next round
+    */
+    uint8_t iNext;
+
+    /**
+     * Number of performed driver steps
+    */
+    uint32_t iSteps;
+
+    public:
+        I2cBusManager(): iWires{ { 0 }, { 1 } }, iDrivers{}, iCount( 0 ), iNext( 0 ), iSteps( 0 )
+        {
+        }
+
+        /**
+         * Initializes a bus
+         *
+         * @param aBus bus number
+         * @param aSDA SDA pin number
+         * @param aSCL SCL pin number
+         * @param aFrequency frequency of CLK signal in Hz
+         * @return False if bus does not exist or failed to start
+        */
+        bool Begin( const uint8_t aBus, const uint8_t aSDA, const uint8_t aSCL, const uint32_t aFrequency );
+
+        /**
+         * Returns controller of a bus for drivers to be constructed with
+         *
+         * @param aBus bus number, must be less than I2C_NUM_OF_BUSES
+        */
+        TwoWire& GetWire( const uint8_t aBus )
+        {
+            return iWires[aBus];
+        }
+
+        /**
+         * Registers a driver to be scheduled by Update()
+         *
+         * @param aDriver driver
+         * @return False if there are too many drivers
+        */
+        bool Add( I2cDriver &aDriver );
+
+        /**
+         * Steps every driver whose deadline passed, earliest deadline first,
+         * drivers with equal deadlines are served round-robin
+        */
+        void Update();
+
+        /**
+         * Returns the earliest deadline of registered drivers
+         *
+         * @param aIdleUs returned when there is no driver, relative to now
+         * @return time the buses are needed next, micros()
+        */
+        uint32_t GetDeadlineUs( const uint32_t aIdleUs ) const;
+
+        uint32_t GetSteps() const
+        {
+            return iSteps;
+        }
+};
+
+#endif /* __I2C_BUS_MANAGER_H__ */
@@ -2,16 +2,37 @@
 #include <stdbool.h>
 #include <Arduino.h>
 #include "Interrupt.h"
-#include "MotionSensor.h"
 
 Interrupt* Interrupt::iISRVectorTable[MAX_NUM_OF_INTERRUPTS];
+SpscQueue<InterruptEvent, INTERRUPT_EVENT_QUEUE_SIZE> Interrupt::iEventQueue;
 
-void Interrupt::Interrupt_0()
+bool IRAM_ATTR Interrupt::PostEvent( const uint8_t aSource, const uint32_t aData )
 {
-    iISRVectorTable[0]->ISR();
+    return iEventQueue.Push( { aSource, (uint32_t) micros(), aData } );
 }
 
-void Interrupt::Register( const uint8_t aInterruptNumber, Interrupt* aIntThisPtr )
+bool Interrupt::Register( const uint8_t aInterruptNumber, Interrupt* aIntThisPtr )
 {
+    if ( aInterruptNumber >= MAX_NUM_OF_INTERRUPTS )
+    {
+        return false;
+    }
+
+    // The same handler may register again, e.g. after being detached
+    if ( ( iISRVectorTable[aInterruptNumber] != nullptr ) && ( iISRVectorTable[aInterruptNumber] != aIntThisPtr ) )
+    {
+        return false;
+    }
+
     iISRVectorTable[aInterruptNumber] = aIntThisPtr;
-}
\ No newline at end of file
+
+    return true;
+}
+
+void Interrupt::Unregister( const uint8_t aInterruptNumber )
+{
+    if ( aInterruptNumber < MAX_NUM_OF_INTERRUPTS )
+    {
+        iISRVectorTable[aInterruptNumber] = nullptr;
+    }
+}
@@ -1,21 +1,188 @@
 #ifndef __INTERRUPT_H__
 #define __INTERRUPT_H__
 
+#include <stdint.h>
+#include <stdbool.h>
+#include <type_traits>
+#include <Arduino.h>
+#include "SpscQueue.h"
+
 #define MAX_NUM_OF_INTERRUPTS       10
 
+/**
+ * Capacity of the queue of events passed from interrupts to the main loop
+ */
+#define INTERRUPT_EVENT_QUEUE_SIZE  32
+
+/**
+ * Claims a slot of the interrupt vector table for an owner
+ *
+ * Every slot passed to Interrupt::Attach() must be claimed exactly once in the
+ * whole firmware. A missing claim fails at link time with an undefined
+ * reference, a second claim fails with a redefinition in the same translation
+ * unit or with a multiple definition error at link time.
+ */
+#define CLAIM_INTERRUPT_SLOT( aSlot, aOwner ) \
+    template<> const char* const InterruptSlot<aSlot>::iOwner = #aOwner
+
+/**
+ * Owner of a slot of the interrupt vector table, defined by CLAIM_INTERRUPT_SLOT
+ */
+template<uint8_t N>
+struct InterruptSlot
+{
+    static const char* const iOwner;
+};
+
+/**
+ * Enum representing GPIO edges an interrupt can be attached to
+ */
+enum InterruptEdge : uint8_t
+{
+    eRising = RISING,
+    eFalling = FALLING,
+    eChange = CHANGE
+};
+
+/**
+ * Event passed from interrupt context to the main loop
+ */
+struct InterruptEvent
+{
+    /**
+     * Slot of the vector table the event comes from
+    */
+    uint8_t iSource;
+
+    /**
+     * Time of the event, micros()
+    */
+    uint32_t iTimestamp;
+
+    /**
+     * Data defined by the source
+    */
+    uint32_t iData;
+};
+
 class Interrupt
 {
     static Interrupt* iISRVectorTable[MAX_NUM_OF_INTERRUPTS];
 
+    /**
+     * Events posted by handlers, all GPIO interrupts run on the same level
+     * and do not nest, so they form a single producer
+    */
+    static SpscQueue<InterruptEvent, INTERRUPT_EVENT_QUEUE_SIZE> iEventQueue;
+
+    /**
+     * Entry point of a slot placed in IRAM
+     *
+     * The handler is called non-virtually through its concrete type, so the
+     * dispatch reads neither a vtable nor anything else from flash.
+    */
+    template<uint8_t N, typename T>
+    static void IRAM_ATTR Trampoline()
+    {
+        static_cast<T*>( iISRVectorTable[N] )->T::ISR();
+    }
+
     public:
         Interrupt()
         {}
 
-        static void Register( const uint8_t aInterruptNumber, Interrupt* aIntThisPtr );
+        /**
+         * Stores a handler in the vector table
+         *
+         * @param aInterruptNumber slot of the vector table
+         * @param aIntThisPtr handler
+         * @return False if slot is out of range or already taken by another handler
+        */
+        static bool Register( const uint8_t aInterruptNumber, Interrupt* aIntThisPtr );
+
+        /**
+         * Frees a slot of the vector table
+         *
+         * @param aInterruptNumber slot of the vector table
+        */
+        static void Unregister( const uint8_t aInterruptNumber );
+
+        /**
+         * Registers a handler in slot N and attaches its trampoline to a GPIO edge
+         *
+         * @param aHandler handler, its ISR() must be placed in IRAM
+         * @param aPin GPIO pin number
+         * @param aEdge edge triggering the interrupt
+         * @return False if slot is already taken at run time
+        */
+        template<uint8_t N, typename T>
+        static bool Attach( T &aHandler, const uint8_t aPin, const InterruptEdge aEdge )
+        {
+            static_assert( N < MAX_NUM_OF_INTERRUPTS, "Interrupt slot out of range" );
+            static_assert( std::is_base_of<Interrupt, T>::value, "Interrupt handler must derive from Interrupt" );
+
+            if ( !Register( N, &aHandler ) )
+            {
+                Serial.printf( "Interrupt slot %u already taken, owner %s\n", N, InterruptSlot<N>::iOwner );
+                return false;
+            }
+
+            attachInterrupt( digitalPinToInterrupt( aPin ), Trampoline<N, T>, aEdge );
+
+            return true;
+        }
+
+        /**
+         * Detaches a GPIO interrupt and frees slot N
+         *
+         * @param aPin GPIO pin number
+        */
+        template<uint8_t N>
+        static void Detach( const uint8_t aPin )
+        {
+            static_assert( N < MAX_NUM_OF_INTERRUPTS, "Interrupt slot out of range" );
+
+            detachInterrupt( digitalPinToInterrupt( aPin ) );
+            Unregister( N );
+        }
+
+        /**
+         * Posts an event to the main loop, callable from interrupt context
+         *
+         * @param aSource slot of the posting handler
+         * @param aData data of the event
+         * @return False if the queue is full and the event was dropped
+        */
+        static bool PostEvent( const uint8_t aSource, const uint32_t aData );
+
+        /**
+         * Takes the oldest posted event, main loop only
+         *
+         * @param aEvent taken event
+         * @return False if there is no event
+        */
+        static bool PollEvent( InterruptEvent &aEvent )
+        {
+            return iEventQueue.Pop( aEvent );
+        }
+
+        /**
+         * Returns number of events dropped because the queue was full
+        */
+        static uint32_t GetEventOverflows()
+        {
+            return iEventQueue.GetOverflows();
+        }
+
+        /**
+         * Returns the highest number of events waiting in the queue
+        */
+        static uint32_t GetEventHighWater()
+        {
+            return iEventQueue.GetHighWater();
+        }
 
-        static void Interrupt_0();
-        
-        virtual void ISR() = 0; 
+        virtual void ISR() = 0;
 };
 
-#endif /* __INTERRUPT_H__ */
\ No newline at end of file
+#endif /* __INTERRUPT_H__ */
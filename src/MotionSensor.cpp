@@ -2,4 +2,17 @@
 #include <stdbool.h>
 #include <Arduino.h>
 #include "Interrupt.h"
-#include "MotionSensor.h"
\ No newline at end of file
+#include "MotionSensor.h"
+
+CLAIM_INTERRUPT_SLOT( MOTION_INTERRUPT_NUMBER, MotionSensor );
+
+bool MotionSensor::EnableInterrupt()
+{
+    return Attach<MOTION_INTERRUPT_NUMBER>( *this, iPin, eChange );
+}
+
+void IRAM_ATTR MotionSensor::ISR()
+{
+    // Level after the edge tells its direction
+    PostEvent( MOTION_INTERRUPT_NUMBER, digitalRead( iPin ) );
+}
@@ -1,23 +1,42 @@
 #ifndef __MOTION_H__
 #define __MOTION_H__
 
+#include "Interrupt.h"
+
 /* Motion sensor DIO pin nubmer */
 #define MOTION_SENSOR_PIN       15
 
-class MotionSensor
+/* Slot of the interrupt vector table used by motion sensor */
+#define MOTION_INTERRUPT_NUMBER 0
+
+class MotionSensor: public Interrupt
 {
     uint8_t iPin;
 
     public:
         MotionSensor( uint8_t aPin ): iPin( aPin )
         {
-            pinMode( iPin, INPUT );       
+            pinMode( iPin, INPUT );
         }
 
+        /**
+         * Starts capturing edges of the sensor output in an interrupt
+         *
+         * @return False if the interrupt slot is taken
+        */
+        bool EnableInterrupt();
+
+        /**
+         * Posts an edge of the sensor output to the interrupt event queue,
+         * runs in interrupt context. Event data is 1 for motion start
+         * (rising edge) and 0 for motion end.
+        */
+        void ISR() override;
+
         bool IsMovement() const
         {
             return digitalRead( iPin );
         }
 };
 
-#endif /* __MOTION_H__ */
\ No newline at end of file
+#endif /* __MOTION_H__ */
@@ -0,0 +1,71 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <Arduino.h>
+#include "MqttConnection.h"
+
+void MqttConnection::TryConnect()
+{
+    Serial.print( "Attempting MQTT connection..." );
+
+    // Bound the time a single attempt may block the loop
+    iClient.setSocketTimeout( MQTT_SOCKET_TIMEOUT_S );
+
+    if ( iClient.connect( iClientId, iUser, iPassword ) )
+    {
+        Serial.println( "connected" );
+
+        iState = eConnected;
+        iBackoffMs = MQTT_BACKOFF_MIN_MS;
+        iDisconnectedMs += (uint32_t)( millis() - iDownSince );
+
+        if ( iOnConnected != nullptr )
+        {
+            iOnConnected( iClient );
+        }
+    }
+    else
+    {
+        Serial.printf( "failed, rc=%d, next try in %u ms\n", iClient.state(), iBackoffMs );
+
+        // Random jitter keeps a fleet from reconnecting in lockstep after a broker restart
+        iState = eBackoff;
+        iNextAttemptTime = millis() + iBackoffMs + random( iBackoffMs / 4 + 1 );
+        iBackoffMs = ( iBackoffMs * 2 > MQTT_BACKOFF_MAX_MS ) ? MQTT_BACKOFF_MAX_MS : iBackoffMs * 2;
+    }
+}
+
+void MqttConnection::Step()
+{
+    const uint32_t now = millis();
+
+    iIterations++;
+
+    if ( iState == eConnected )
+    {
+        if ( iClient.connected() )
+        {
+            iClient.loop();
+            return;
+        }
+
+        // Link dropped, first attempt is made right away
+        Serial.println( "MQTT connection lost" );
+
+        iState = eDisconnected;
+        iDownSince = now;
+        iNextAttemptTime = now;
+    }
+
+    iOfflineIterations++;
+
+    // Wrap-safe while the deadline is less than 2^31 ms away
+    if ( (int32_t)( now - iNextAttemptTime ) >= 0 )
+    {
+        TryConnect();
+    }
+}
+
+uint64_t MqttConnection::GetDisconnectedMs() const
+{
+    return ( iState == eConnected ) ? iDisconnectedMs : iDisconnectedMs + (uint32_t)( millis() - iDownSince );
+}
@@ -0,0 +1,173 @@
+#ifndef __MQTT_CONNECTION_H__
+#define __MQTT_CONNECTION_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <Arduino.h>
+#include <PubSubClient.h>
+
+/**
+ * Delay before the first reconnect attempt in milliseconds
+ */
+#define MQTT_BACKOFF_MIN_MS     500
+
+/**
+ * Upper limit of the reconnect delay in milliseconds
+ */
+#define MQTT_BACKOFF_MAX_MS     60000
+
+/**
+ * Socket timeout of a single connect attempt in seconds
+ */
+#define MQTT_SOCKET_TIMEOUT_S   2
+
+class MqttConnection
+{
+    public:
+        /**
+         * Enum representing state of the connection
+        */
+        enum State
+        {
+            eDisconnected,
+            eBackoff,
+            eConnected
+        };
+
+        /**
+         * Function called after every successful connect, used to subscribe topics
+        */
+        typedef void ( *ConnectedHandler )( PubSubClient &aClient );
+
+    private:
+        /**
+         * MQTT client the connection is managed for
+        */
+        PubSubClient &iClient;
+
+        /**
+         * Credentials used to connect
+        */
+        const char *iClientId;
+        const char *iUser;
+        const char *iPassword;
+
+        ConnectedHandler iOnConnected;
+
+        State iState;
+
+        /**
+         * Current reconnect delay and time of the next attempt
+        */
+        uint32_t iBackoffMs;
+        uint32_t iNextAttemptTime;
+
+        /**
+         * Timestamp the link went down, valid while disconnected
+        */
+        uint32_t iDownSince;
+
+        /**
+         * Total time spent disconnected in milliseconds, ongoing outage excluded
+        */
+        uint64_t iDisconnectedMs;
+
+        /**
+         * Number of Step() calls in total and while the link was down
+        */
+        uint32_t iIterations;
+        uint32_t iOfflineIterations;
+
+        /**
+         * Makes one connect attempt and schedules the next one on failure
+        */
+        void TryConnect();
+
+    public:
+        /**
+         * Constructor for MQTT connection manager
+         *
+         * @param aClient MQTT client to manage
+         * @param aOnConnected function called after each successful connect
+        */
+        MqttConnection( PubSubClient &aClient, ConnectedHandler aOnConnected ):
+            iClient( aClient ),
+            iClientId( "" ),
+            iUser( nullptr ),
+            iPassword( nullptr ),
+            iOnConnected( aOnConnected ),
+            iState( eDisconnected ),
+            iBackoffMs( MQTT_BACKOFF_MIN_MS ),
+            iNextAttemptTime( 0 ),
+            iDownSince( 0 ),
+            iDisconnectedMs( 0 ),
+            iIterations( 0 ),
+            iOfflineIterations( 0 )
+        {
+        }
+
+        /**
+         * Sets credentials used by following connect attempts, strings must outlive the connection.
+         * Disconnected time of the first connect is counted from here, not from boot.
+         *
+         * @param aClientId client identifier sent to the broker
+         * @param aUser user name
+         * @param aPassword password
+        */
+        void SetCredentials( const char *aClientId, const char *aUser, const char *aPassword )
+        {
+            iClientId = aClientId;
+            iUser = aUser;
+            iPassword = aPassword;
+
+            if ( iState != eConnected )
+            {
+                iDownSince = millis();
+            }
+        }
+
+        /**
+         * Advances the connection state machine, never waits for the broker
+         * longer than one connect attempt
+        */
+        void Step();
+
+        bool IsConnected() const
+        {
+            return iState == eConnected;
+        }
+
+        State GetState() const
+        {
+            return iState;
+        }
+
+        /**
+         * Returns total time spent disconnected including an ongoing outage
+         *
+         * @return time in milliseconds
+        */
+        uint64_t GetDisconnectedMs() const;
+
+        /**
+         * Returns number of loop iterations served
+         *
+         * @return number of Step() calls
+        */
+        uint32_t GetIterations() const
+        {
+            return iIterations;
+        }
+
+        /**
+         * Returns number of loop iterations served while disconnected
+         *
+         * @return number of Step() calls without connection
+        */
+        uint32_t GetOfflineIterations() const
+        {
+            return iOfflineIterations;
+        }
+};
+
+#endif /* __MQTT_CONNECTION_H__ */
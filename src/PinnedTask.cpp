@@ -0,0 +1,69 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "PinnedTask.h"
+
+void PinnedTask::Entry( void *aTask )
+{
+    static_cast<PinnedTask*>( aTask )->Run();
+}
+
+void PinnedTask::Run()
+{
+    const uint32_t tick_us = portTICK_PERIOD_MS * 1000;
+
+    iWindowStartUs = micros();
+
+    for ( ;; )
+    {
+        const uint32_t start = micros();
+
+        const uint32_t wait_us = iBody();
+
+        const uint32_t busy = micros() - start;
+
+        iIterations = iIterations + 1;
+        iMaxBusyUs = ( busy > iMaxBusyUs ) ? busy : iMaxBusyUs;
+        iWindowBusyUs += busy;
+
+        const uint32_t elapsed = micros() - iWindowStartUs;
+
+        if ( elapsed >= TASK_LOAD_WINDOW_US )
+        {
+            iLoadPermille = (uint16_t)( (uint64_t) iWindowBusyUs * 1000 / elapsed );
+            iWindowStartUs += elapsed;
+            iWindowBusyUs = 0;
+        }
+
+        // Sleeping lets the idle task halt the core, a due body only yields.
+        // Waits are rounded up to whole ticks, so the body never runs early
+        vTaskDelay( ( wait_us + tick_us - 1 ) / tick_us );
+    }
+}
+
+bool PinnedTask::Start()
+{
+    if ( iHandle != nullptr )
+    {
+        return false;
+    }
+
+    return xTaskCreatePinnedToCore( Entry, iConfig.iName, iConfig.iStackBytes, this,
+                                    iConfig.iPriority, &iHandle, iConfig.iCore ) == pdPASS;
+}
+
+TaskMetrics PinnedTask::GetMetrics() const
+{
+    TaskMetrics metrics;
+
+    metrics.iIterations = iIterations;
+    metrics.iLoadPermille = iLoadPermille;
+    metrics.iMaxBusyUs = iMaxBusyUs;
+
+    // ESP-IDF reports the high-water mark of the stack in bytes
+    metrics.iStackFreeBytes = ( iHandle != nullptr ) ? uxTaskGetStackHighWaterMark( iHandle ) : 0;
+
+    return metrics;
+}
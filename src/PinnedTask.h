@@ -0,0 +1,119 @@
+#ifndef __PINNED_TASK_H__
+#define __PINNED_TASK_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/**
+ * Time over which CPU load of a task is measured
+ */
+#define TASK_LOAD_WINDOW_US     1000000
+
+/**
+ * Configuration of a task pinned to a core
+ */
+struct TaskConfig
+{
+    const char *iName;
+
+    /**
+     * Core the task runs on, 0 runs Wi-Fi, 1 runs Arduino loop()
+    */
+    uint8_t iCore;
+
+    /**
+     * FreeRTOS priority, higher preempts lower on the same core
+    */
+    uint8_t iPriority;
+
+    uint32_t iStackBytes;
+};
+
+/**
+ * Load and stack usage of a task
+ */
+struct TaskMetrics
+{
+    uint32_t iIterations;
+
+    /**
+     * Share of time spent in the body over the last load window, per mille
+    */
+    uint16_t iLoadPermille;
+
+    /**
+     * Longest iteration of the body
+    */
+    uint32_t iMaxBusyUs;
+
+    /**
+     * Least free stack seen since the task started
+    */
+    uint32_t iStackFreeBytes;
+};
+
+/**
+ * FreeRTOS task pinned to a core, calls its body and sleeps as long as the
+ * body asks for
+ *
+ * The body must not block for long, it shares the core with other tasks of
+ * the same priority. Metrics are written by the task and may be read from
+ * any other task.
+ */
+class PinnedTask
+{
+    TaskConfig iConfig;
+
+    /**
+     * Body of the task, returns microseconds until it needs to run again
+    */
+    uint32_t ( *iBody )();
+
+    TaskHandle_t iHandle;
+
+    volatile uint32_t iIterations;
+    volatile uint16_t iLoadPermille;
+    volatile uint32_t iMaxBusyUs;
+
+    /**
+     * Start of the current load window and time spent in the body within it
+    */
+    uint32_t iWindowStartUs;
+    uint32_t iWindowBusyUs;
+
+    static void Entry( void *aTask );
+
+    void Run();
+
+    public:
+        PinnedTask( const TaskConfig &aConfig, uint32_t ( *aBody )() ):
+            iConfig( aConfig ),
+            iBody( aBody ),
+            iHandle( nullptr ),
+            iIterations( 0 ),
+            iLoadPermille( 0 ),
+            iMaxBusyUs( 0 ),
+            iWindowStartUs( 0 ),
+            iWindowBusyUs( 0 )
+        {
+        }
+
+        /**
+         * Creates the task, its body starts running right away
+         *
+         * @return False if the task could not be created
+        */
+        bool Start();
+
+        TaskMetrics GetMetrics() const;
+
+        const TaskConfig& GetConfig() const
+        {
+            return iConfig;
+        }
+};
+
+#endif /* __PINNED_TASK_H__ */
@@ -0,0 +1,180 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "ReadingFilter.h"
+
+void WindowStats::Add( const int32_t aValue )
+{
+    if ( iCount >= FILTER_WINDOW_MAX_COUNT )
+    {
+        return;
+    }
+
+    if ( iCount == 0 )
+    {
+        iFirst = aValue;
+        iMin = aValue;
+        iMax = aValue;
+    }
+
+    const int64_t delta = (int64_t) aValue - iFirst;
+
+    iMin = ( aValue < iMin ) ? aValue : iMin;
+    iMax = ( aValue > iMax ) ? aValue : iMax;
+    iSum += delta;
+    iSumSq += (uint64_t)( delta * delta );
+    iCount++;
+}
+
+int32_t WindowStats::GetMean() const
+{
+    if ( iCount == 0 )
+    {
+        return 0;
+    }
+
+    // Round half away from zero
+    const int64_t half = ( iSum < 0 ) ? -( iCount / 2 ) : iCount / 2;
+
+    return iFirst + (int32_t)( ( iSum + half ) / iCount );
+}
+
+uint32_t WindowStats::GetStdDev() const
+{
+    if ( iCount == 0 )
+    {
+        return 0;
+    }
+
+    // n^2 * variance = n * sum(d^2) - sum(d)^2, exact in integers
+    const uint64_t sum_abs = ( iSum < 0 ) ? -iSum : iSum;
+    const uint64_t scaled = iCount * iSumSq - sum_abs * sum_abs;
+    const uint64_t variance = scaled / ( (uint64_t) iCount * iCount );
+
+    // Integer square root, one bit of the result per iteration
+    uint64_t root = 0;
+    uint64_t bit = (uint64_t) 1 << 62;
+    uint64_t rest = variance;
+
+    while ( bit > rest )
+    {
+        bit >>= 2;
+    }
+
+    while ( bit != 0 )
+    {
+        if ( rest >= root + bit )
+        {
+            rest -= root + bit;
+            root = ( root >> 1 ) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+
+        bit >>= 2;
+    }
+
+    return (uint32_t) root;
+}
+
+int32_t ReadingFilter::GetMedian() const
+{
+    int32_t sorted[FILTER_MAX_MEDIAN];
+
+    // Insertion sort, the window is a handful of readings
+    for ( uint8_t idx = 0; idx < iHistoryCount; ++idx )
+    {
+        uint8_t pos = idx;
+
+        for ( ; ( pos > 0 ) && ( sorted[pos - 1] > iHistory[idx] ); --pos )
+        {
+            sorted[pos] = sorted[pos - 1];
+        }
+
+        sorted[pos] = iHistory[idx];
+    }
+
+    return sorted[iHistoryCount / 2];
+}
+
+bool ReadingFilter::Add( const int32_t aValue )
+{
+    const uint8_t length = ( iConfig.iMedianLength == 0 ) ? 1 :
+                           ( iConfig.iMedianLength > FILTER_MAX_MEDIAN ) ? FILTER_MAX_MEDIAN : iConfig.iMedianLength;
+
+    iHistory[iHistoryPos] = aValue;
+    iHistoryPos = ( iHistoryPos + 1 ) % length;
+    iHistoryCount = ( iHistoryCount < length ) ? iHistoryCount + 1 : length;
+
+    const int32_t median = GetMedian();
+
+    if ( iPrimed && ( iConfig.iOutlierCenti != 0 ) )
+    {
+        const int32_t distance = median - GetValue();
+        const bool outlier = ( distance > iConfig.iOutlierCenti ) || ( -distance > iConfig.iOutlierCenti );
+
+        if ( outlier && ( iOutlierRun < iConfig.iMaxOutliers ) )
+        {
+            iOutlierRun++;
+            iRejected++;
+            return false;
+        }
+
+        // Too many outliers in a row are a real step, the EMA jumps to it
+        if ( outlier )
+        {
+            iPrimed = false;
+        }
+    }
+
+    iOutlierRun = 0;
+
+    if ( !iPrimed )
+    {
+        iEma = median * ( 1 << FILTER_EMA_FRACTION );
+        iPrimed = true;
+    }
+    else
+    {
+        // Arithmetic shift keeps the sign of the step
+        iEma += ( median * ( 1 << FILTER_EMA_FRACTION ) - iEma ) >> iConfig.iEmaShift;
+    }
+
+    iWindow.Add( median );
+
+    return true;
+}
+
+WindowRecord ReadingFilter::TakeWindow()
+{
+    WindowRecord record;
+
+    record.iCount = iWindow.GetCount();
+    record.iRejected = iRejected;
+    record.iMin = iWindow.GetMin();
+    record.iMax = iWindow.GetMax();
+    record.iMean = iWindow.GetMean();
+    record.iStdDev = iWindow.GetStdDev();
+
+    iWindow.Reset();
+    iRejected = 0;
+
+    return record;
+}
+
+void ReadingFilter::SetConfig( const FilterConfig &aConfig )
+{
+    iConfig = aConfig;
+
+    // A larger shift would leave the EMA stuck, 32 or more is undefined
+    if ( iConfig.iEmaShift > FILTER_EMA_FRACTION )
+    {
+        iConfig.iEmaShift = FILTER_EMA_FRACTION;
+    }
+
+    // History length may have changed, start over with the next reading
+    iHistoryCount = 0;
+    iHistoryPos = 0;
+    iOutlierRun = 0;
+}
@@ -0,0 +1,211 @@
+#ifndef __READING_FILTER_H__
+#define __READING_FILTER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Maximal length of the median filter
+ */
+#define FILTER_MAX_MEDIAN       7
+
+/**
+ * Number of fractional bits of the EMA state
+ */
+#define FILTER_EMA_FRACTION     8
+
+/**
+ * Number of samples a window accumulates at most, keeps the sums in 64 bits
+ */
+#define FILTER_WINDOW_MAX_COUNT 32767
+
+/**
+ * Configuration of the filter stage, values are in hundredths of the unit
+ */
+struct FilterConfig
+{
+    /**
+     * Number of the latest readings the median is taken of, one disables the median
+    */
+    uint8_t iMedianLength;
+
+    /**
+     * EMA weight of a new reading is 1 / 2^iEmaShift, zero disables smoothing,
+     * at most FILTER_EMA_FRACTION
+    */
+    uint8_t iEmaShift;
+
+    /**
+     * Readings further than this from the EMA are outliers, zero disables rejection
+    */
+    uint16_t iOutlierCenti;
+
+    /**
+     * Number of consecutive outliers taken as a real step change and accepted
+    */
+    uint8_t iMaxOutliers;
+};
+
+/**
+ * Aggregate of the readings accepted within a reporting window
+ */
+struct WindowRecord
+{
+    uint16_t iCount;
+    uint16_t iRejected;
+    int32_t iMin;
+    int32_t iMax;
+    int32_t iMean;
+    uint32_t iStdDev;
+};
+
+/**
+ * Incremental statistics of a window, O(1) per sample, readings are not stored
+ *
+ * Sums are kept relative to the first reading, which keeps them small and the
+ * variance exact in integers.
+ */
+class WindowStats
+{
+    uint16_t iCount;
+    int32_t iFirst;
+    int32_t iMin;
+    int32_t iMax;
+    int64_t iSum;
+    uint64_t iSumSq;
+
+    public:
+        WindowStats()
+        {
+            Reset();
+        }
+
+        void Reset()
+        {
+            iCount = 0;
+            iFirst = 0;
+            iMin = 0;
+            iMax = 0;
+            iSum = 0;
+            iSumSq = 0;
+        }
+
+        void Add( const int32_t aValue );
+
+        uint16_t GetCount() const
+        {
+            return iCount;
+        }
+
+        int32_t GetMin() const
+        {
+            return iMin;
+        }
+
+        int32_t GetMax() const
+        {
+            return iMax;
+        }
+
+        /**
+         * Returns mean rounded to the nearest integer, zero for an empty window
+        */
+        int32_t GetMean() const;
+
+        /**
+         * Returns population standard deviation rounded down, zero for an empty window
+        */
+        uint32_t GetStdDev() const;
+};
+
+/**
+ * Streaming filter of one quantity: median of the latest readings, outlier
+ * rejection against the smoothed value and exponential moving average
+ */
+class ReadingFilter
+{
+    FilterConfig iConfig;
+
+    /**
+     * The latest raw readings for the median, ring buffer
+    */
+    int32_t iHistory[FILTER_MAX_MEDIAN];
+    uint8_t iHistoryCount;
+    uint8_t iHistoryPos;
+
+    /**
+     * EMA state with FILTER_EMA_FRACTION fractional bits, valid once primed
+    */
+    int32_t iEma;
+    bool iPrimed;
+
+    /**
+     * Number of consecutive rejected readings
+    */
+    uint8_t iOutlierRun;
+
+    /**
+     * Number of readings rejected in the current window
+    */
+    uint16_t iRejected;
+
+    WindowStats iWindow;
+
+    int32_t GetMedian() const;
+
+    public:
+        ReadingFilter( const FilterConfig &aConfig ):
+            iHistory{},
+            iHistoryCount( 0 ),
+            iHistoryPos( 0 ),
+            iEma( 0 ),
+            iPrimed( false ),
+            iOutlierRun( 0 ),
+            iRejected( 0 )
+        {
+            SetConfig( aConfig );
+        }
+
+        /**
+         * Passes a new reading through the filter stage
+         *
+         * @param aValue reading in hundredths of the unit
+         * @return False if the reading was rejected as an outlier
+        */
+        bool Add( const int32_t aValue );
+
+        /**
+         * Returns true once the first reading was accepted
+        */
+        bool IsPrimed() const
+        {
+            return iPrimed;
+        }
+
+        /**
+         * Returns the filtered value rounded to the nearest hundredth
+        */
+        int32_t GetValue() const
+        {
+            return ( iEma + ( 1 << ( FILTER_EMA_FRACTION - 1 ) ) ) >> FILTER_EMA_FRACTION;
+        }
+
+        /**
+         * Returns aggregate of the current window and starts a new one
+        */
+        WindowRecord TakeWindow();
+
+        /**
+         * Changes filter parameters, EMA shift is clamped to FILTER_EMA_FRACTION
+         *
+         * @param aConfig new parameters
+        */
+        void SetConfig( const FilterConfig &aConfig );
+
+        const FilterConfig& GetConfig() const
+        {
+            return iConfig;
+        }
+};
+
+#endif /* __READING_FILTER_H__ */
@@ -0,0 +1,65 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "RtcSampleLog.h"
+
+void RtcSampleLog::Add( const LoggedSample &aSample )
+{
+    if ( iCount == RTC_LOG_CAPACITY )
+    {
+        iHead = ( iHead + 1 ) % RTC_LOG_CAPACITY;
+        iCount--;
+        iDropped++;
+    }
+
+    iSamples[( iHead + iCount ) % RTC_LOG_CAPACITY] = aSample;
+    iCount++;
+    iNextSeq++;
+
+    // Saturates instead of wrapping back below the flush period
+    iWakesSinceAttempt = ( iWakesSinceAttempt < UINT8_MAX ) ? iWakesSinceAttempt + 1 : UINT8_MAX;
+}
+
+bool RtcSampleLog::IsFlushDue( const FlushPolicy &aPolicy, const bool aUrgent ) const
+{
+    if ( iCount == 0 )
+    {
+        return false;
+    }
+
+    if ( aUrgent || ( iWakesSinceAttempt >= aPolicy.iEveryWakes ) )
+    {
+        return true;
+    }
+
+    // Nothing to compare with before the first flush, and a failing broker
+    // must not keep the radio on every wake-up
+    if ( !iHasFlushed || iRetrying )
+    {
+        return false;
+    }
+
+    const LoggedSample &latest = Get( iCount - 1 );
+    const int32_t temp = latest.iTempCenti - iLastFlushed.iTempCenti;
+    const int32_t hum = latest.iHumCenti - iLastFlushed.iHumCenti;
+
+    // A sample which became valid or invalid is a change as well
+    return ( ( latest.iFlags ^ iLastFlushed.iFlags ) & ( RTC_LOG_TEMP_VALID | RTC_LOG_HUM_VALID ) ) ||
+           ( ( aPolicy.iTempDeltaCenti != 0 ) && ( ( temp >= aPolicy.iTempDeltaCenti ) || ( -temp >= aPolicy.iTempDeltaCenti ) ) ) ||
+           ( ( aPolicy.iHumDeltaCenti != 0 ) && ( ( hum >= aPolicy.iHumDeltaCenti ) || ( -hum >= aPolicy.iHumDeltaCenti ) ) );
+}
+
+void RtcSampleLog::FlushDone( const bool aFlushed )
+{
+    iWakesSinceAttempt = 0;
+    iRetrying = !aFlushed;
+
+    if ( !aFlushed || ( iCount == 0 ) )
+    {
+        return;
+    }
+
+    iLastFlushed = Get( iCount - 1 );
+    iHasFlushed = true;
+    iHead = 0;
+    iCount = 0;
+}
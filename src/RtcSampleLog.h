@@ -0,0 +1,139 @@
+#ifndef __RTC_SAMPLE_LOG_H__
+#define __RTC_SAMPLE_LOG_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Number of samples the log holds, the oldest one is overwritten when full
+ */
+#define RTC_LOG_CAPACITY        32
+
+/**
+ * Flags of a logged sample, same bits as in the binary telemetry frame
+ */
+#define RTC_LOG_MOVEMENT        0x01
+#define RTC_LOG_TEMP_VALID      0x02
+#define RTC_LOG_HUM_VALID       0x04
+
+/**
+ * Sample kept in the log, sequence number follows from its position
+ */
+struct LoggedSample
+{
+    /**
+     * Time the sample was taken at, seconds of the RTC clock running in deep sleep
+    */
+    uint32_t iTimeS;
+
+    int16_t iTempCenti;
+    uint16_t iHumCenti;
+
+    uint8_t iFlags;
+};
+
+/**
+ * Conditions of bringing the radio up to flush the log
+ */
+struct FlushPolicy
+{
+    /**
+     * Flush every Nth wake-up, at most RTC_LOG_CAPACITY to lose no samples
+    */
+    uint8_t iEveryWakes;
+
+    /**
+     * Changes against the last flushed sample flushing right away, 0.01 of the unit
+    */
+    uint16_t iTempDeltaCenti;
+    uint16_t iHumDeltaCenti;
+};
+
+/**
+ * Log of samples surviving deep sleep in RTC slow memory
+ *
+ * The log has no constructor, so an instance placed in RTC_DATA_ATTR memory is
+ * zero-initialized at power-on and left untouched by every wake-up from deep
+ * sleep. A sequence number counts every sample ever added, so the backend can
+ * detect samples lost when the log overflowed.
+ */
+struct RtcSampleLog
+{
+    /**
+     * Ring buffer of samples, iHead points to the oldest one
+    */
+    LoggedSample iSamples[RTC_LOG_CAPACITY];
+    uint8_t iHead;
+    uint8_t iCount;
+
+    /**
+     * Sequence number of the next sample added
+    */
+    uint32_t iNextSeq;
+
+    /**
+     * Samples overwritten before they were flushed
+    */
+    uint32_t iDropped;
+
+    /**
+     * Wake-ups since the last flush attempt, successful or not
+    */
+    uint8_t iWakesSinceAttempt;
+
+    /**
+     * True while the last flush attempt failed, only the period retries then
+    */
+    bool iRetrying;
+
+    /**
+     * The last flushed sample, valid once flushed
+    */
+    LoggedSample iLastFlushed;
+    bool iHasFlushed;
+
+    /**
+     * Appends a sample, overwrites the oldest one if the log is full
+    */
+    void Add( const LoggedSample &aSample );
+
+    /**
+     * Returns the Nth oldest sample
+    */
+    const LoggedSample& Get( const uint8_t aIndex ) const
+    {
+        return iSamples[( iHead + aIndex ) % RTC_LOG_CAPACITY];
+    }
+
+    uint8_t GetCount() const
+    {
+        return iCount;
+    }
+
+    /**
+     * Returns sequence number of the oldest sample
+    */
+    uint32_t GetFirstSeq() const
+    {
+        return iNextSeq - iCount;
+    }
+
+    /**
+     * Tells if the radio should come up to flush the log in this wake-up
+     *
+     * @param aPolicy flush conditions
+     * @param aUrgent true if the wake-up itself needs reporting, e.g. motion or power-on
+     * @return True on every Nth wake-up, when the latest sample changed
+     *         significantly since the last flush or when urgent
+    */
+    bool IsFlushDue( const FlushPolicy &aPolicy, const bool aUrgent ) const;
+
+    /**
+     * Records the result of a flush attempt, a successful flush empties the log
+     *
+     * @param aFlushed true if the whole log was published
+    */
+    void FlushDone( const bool aFlushed );
+};
+
+#endif /* __RTC_SAMPLE_LOG_H__ */
@@ -0,0 +1,72 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "SampleBatch.h"
+
+void SampleBatch::SetConfig( const BatchConfig &aConfig )
+{
+    iConfig = aConfig;
+
+    if ( iConfig.iMaxCount > SAMPLE_BATCH_CAPACITY )
+    {
+        iConfig.iMaxCount = SAMPLE_BATCH_CAPACITY;
+    }
+
+    if ( iConfig.iMaxCount == 0 )
+    {
+        iConfig.iMaxCount = 1;
+    }
+}
+
+void SampleBatch::Push( const TelemetrySample &aSample )
+{
+    const uint8_t tail = ( iHead + iCount ) % SAMPLE_BATCH_CAPACITY;
+
+    iSamples[tail] = aSample;
+
+    if ( iCount < SAMPLE_BATCH_CAPACITY )
+    {
+        iCount++;
+    }
+    else
+    {
+        // Tail caught up with head, the oldest sample was overwritten
+        iHead = ( iHead + 1 ) % SAMPLE_BATCH_CAPACITY;
+        iDropped++;
+    }
+}
+
+bool SampleBatch::IsFlushDue( const uint32_t aNow ) const
+{
+    if ( iCount == 0 )
+    {
+        return false;
+    }
+
+    // One more sample would not fit into the byte budget
+    const uint32_t next_size = iHeaderBytes + (uint32_t)( iCount + 1 ) * iSampleBytes;
+
+    return ( iCount >= iConfig.iMaxCount ) ||
+           ( aNow - iSamples[iHead].iTimestamp >= iConfig.iMaxAgeMs ) ||
+           ( next_size > iConfig.iMaxBytes );
+}
+
+uint8_t SampleBatch::Peek( TelemetrySample aSamples[], const uint8_t aMaxCount ) const
+{
+    uint8_t count = 0;
+
+    while ( ( count < aMaxCount ) && ( count < iCount ) )
+    {
+        aSamples[count] = iSamples[( iHead + count ) % SAMPLE_BATCH_CAPACITY];
+        count++;
+    }
+
+    return count;
+}
+
+void SampleBatch::Discard( const uint8_t aCount )
+{
+    const uint8_t count = ( aCount < iCount ) ? aCount : iCount;
+
+    iHead = ( iHead + count ) % SAMPLE_BATCH_CAPACITY;
+    iCount -= count;
+}
@@ -0,0 +1,153 @@
+#ifndef __SAMPLE_BATCH_H__
+#define __SAMPLE_BATCH_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "TelemetryCodec.h"
+
+/**
+ * Maximal number of samples buffered for one batch
+ */
+#define SAMPLE_BATCH_CAPACITY       32
+
+/**
+ * Configuration of batch flushing, a batch is flushed when any limit is reached
+ */
+struct BatchConfig
+{
+    /**
+     * Number of samples in a batch, one disables batching
+    */
+    uint8_t iMaxCount;
+
+    /**
+     * Age of the oldest buffered sample in milliseconds
+    */
+    uint32_t iMaxAgeMs;
+
+    /**
+     * Size of encoded batch in bytes
+    */
+    uint16_t iMaxBytes;
+};
+
+class SampleBatch
+{
+    /**
+     * Ring buffer of samples, iHead points to the oldest one
+    */
+    TelemetrySample iSamples[SAMPLE_BATCH_CAPACITY];
+    uint8_t iHead;
+    uint8_t iCount;
+
+    BatchConfig iConfig;
+
+    /**
+     * Encoded size of batch header and of one sample, depends on payload format
+    */
+    uint16_t iHeaderBytes;
+    uint16_t iSampleBytes;
+
+    /**
+     * Number of samples overwritten because the buffer was full
+    */
+    uint32_t iDropped;
+
+    public:
+        /**
+         * Constructor for sample batch
+         *
+         * @param aConfig flush limits
+         * @param aHeaderBytes encoded size of batch header in bytes
+         * @param aSampleBytes encoded size of one sample in bytes
+        */
+        SampleBatch( const BatchConfig &aConfig, const uint16_t aHeaderBytes, const uint16_t aSampleBytes ):
+            iHead( 0 ),
+            iCount( 0 ),
+            iHeaderBytes( aHeaderBytes ),
+            iSampleBytes( aSampleBytes ),
+            iDropped( 0 )
+        {
+            SetConfig( aConfig );
+        }
+
+        /**
+         * Changes flush limits, count is clamped to the buffer capacity
+         *
+         * @param aConfig new flush limits
+        */
+        void SetConfig( const BatchConfig &aConfig );
+
+        const BatchConfig& GetConfig() const
+        {
+            return iConfig;
+        }
+
+        /**
+         * Checks if samples are published one by one
+         *
+         * @return True if batch holds a single sample
+        */
+        bool IsDisabled() const
+        {
+            return iConfig.iMaxCount <= 1;
+        }
+
+        /**
+         * Appends a sample, the oldest one is overwritten when the buffer is full
+         *
+         * @param aSample sample to append
+        */
+        void Push( const TelemetrySample &aSample );
+
+        /**
+         * Checks flush limits
+         *
+         * @param aNow current time, millis()
+         * @return True if any limit is reached
+        */
+        bool IsFlushDue( const uint32_t aNow ) const;
+
+        /**
+         * Copies buffered samples out without removing them, oldest first
+         *
+         * @param aSamples output array
+         * @param aMaxCount capacity of output array
+         * @return Number of samples copied
+        */
+        uint8_t Peek( TelemetrySample aSamples[], const uint8_t aMaxCount ) const;
+
+        /**
+         * Removes the oldest samples, e.g. once they were published
+         *
+         * @param aCount number of samples to remove
+        */
+        void Discard( const uint8_t aCount );
+
+        /**
+         * Moves buffered samples out, oldest first
+         *
+         * @param aSamples output array
+         * @param aMaxCount capacity of output array
+         * @return Number of samples moved out
+        */
+        uint8_t Drain( TelemetrySample aSamples[], const uint8_t aMaxCount )
+        {
+            const uint8_t count = Peek( aSamples, aMaxCount );
+            Discard( count );
+            return count;
+        }
+
+        uint8_t GetCount() const
+        {
+            return iCount;
+        }
+
+        uint32_t GetDropped() const
+        {
+            return iDropped;
+        }
+};
+
+#endif /* __SAMPLE_BATCH_H__ */
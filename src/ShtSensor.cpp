@@ -10,12 +10,12 @@ void ShtSensor::FlushData( const uint16_t aMaxFllushes )
     uint16_t flushes = aMaxFllushes; 
     
     // Flush internal buffers of I2C interface
-    flush();
+    iWire.flush();
     
     // Call read function to make sure that there are no bytes in the receive buffer
-    while( available() && flushes --> 0 )
+    while( iWire.available() && flushes --> 0 )
     {
-        read();
+        iWire.read();
     }
 }
 
@@ -27,115 +27,261 @@ bool ShtSensor::SendCommand( ShtCmdBase &aCmd )
     // Flush I2C interface before transmission starts
     FlushData( 1000 );
 
-    beginTransmission( iAddr );
+    iWire.beginTransmission( iAddr );
     // Command is successfully sent if number of sent bytes equals to size of a command
-    success = write( &(aCmd[0]), cmd_size ) == cmd_size;  
-    endTransmission();
+    success = iWire.write( &(aCmd[0]), cmd_size ) == cmd_size;  
+    // and sensor acknowledged it
+    success = ( iWire.endTransmission() == 0 ) && success;
+
+    if ( success )
+    {
+        iStats.iCommands++;
+    }
+    else
+    {
+        iStats.iBusErrors++;
+        iErrorCode = ShtSensorErr::eNotResponding;
+    }
 
     return success;
 }
 
-bool ShtSensor::ReceiveResponse( ShtDataResponse &aResponse, const uint8_t aTimeout )
+bool ShtSensor::ReadResponse( ShtDataResponse &aResponse )
 {
     const uint8_t response_size = aResponse.GetSize();
-    
-    uint8_t rx_count = 0;
-    bool tm_elapsed = false;
 
-    const uint64_t timeout = millis() + aTimeout;
+    // Sensor NACKs the read if there is no new result
+    if ( iWire.requestFrom( iAddr, response_size ) != response_size )
+    {
+        iStats.iNotReady++;
+        return false;
+    }
 
-    // Try to receive response from SHT sensor
-    while ( ( rx_count < response_size ) && !tm_elapsed )
+    for ( uint8_t byte = 0; ( byte < response_size ) && iWire.available(); ++byte )
     {
-        rx_count = requestFrom( iAddr, response_size );
-        tm_elapsed = millis() > timeout;
+        aResponse[byte] = iWire.read();
     }
 
-    // Get received data if timeout not elapsed
-    if ( !tm_elapsed )
+    // Response received so set error code to eNoError
+    iErrorCode = ShtSensorErr::eNoError;
+
+    return true;
+}
+
+bool ShtSensor::QueueCommand( ShtCmdBase &aCmd, const uint16_t aPeriodMs, const ShtRepeatability aRepeat )
+{
+    if ( iQueueCount >= SHT_CMD_QUEUE_SIZE )
     {
-        for ( uint8_t byte = 0; ( byte < response_size ) && available(); ++byte )
-        {
-            aResponse[byte] = read();
-        }
+        return false;
+    }
+
+    QueuedCmd &queued = iQueue[( iQueueHead + iQueueCount ) % SHT_CMD_QUEUE_SIZE];
+
+    queued.iMSB = aCmd[0];
+    queued.iLSB = aCmd[1];
+    queued.iPeriodMs = aPeriodMs;
+    queued.iMeasTimeUs = ShtMeasurementTimeUs( aRepeat );
+    iQueueCount++;
+
+    return true;
+}
+
+void ShtSensor::SendQueued()
+{
+    const QueuedCmd queued = iQueue[iQueueHead];
+    ShtCmdBase cmd( queued.iMSB, queued.iLSB );
+
+    iQueueHead = ( iQueueHead + 1 ) % SHT_CMD_QUEUE_SIZE;
+    iQueueCount--;
+
+    // Rejected command is dropped, the sensor stays in its mode
+    if ( !SendCommand( cmd ) )
+    {
+        return;
+    }
+
+    iPeriodMs = queued.iPeriodMs;
+    iLastCmdTime = millis();
+    iLastDataTime = iLastCmdTime;
+
+    // First result is ready after one measurement, then once a period
+    iFetchDelayMs = queued.iMeasTimeUs / 1000 + 1;
+}
+
+void ShtSensor::StartMeasurement()
+{
+    if ( ( millis() - iLastCmdTime ) < iShotIntervalMs )
+    {
+        return;
+    }
+
+    SingleShotCmd shot_cmd( iRepeat, iClkStretch );
+
+    iLastCmdTime = millis();
+
+    if ( !SendCommand( shot_cmd ) )
+    {
+        return;
     }
 
-    return ( rx_count == response_size );
+    const uint32_t now = micros();
+
+    iState = eWaitResponse;
+    iTimeoutUs = now + SHT_RESPONSE_TIMEOUT_MS * 1000;
+
+    // With clock stretching the sensor holds the bus until data are measured,
+    // so the read starts right away
+    if ( iClkStretch == SingleShotCmd::eEnabled )
+    {
+        iDeadlineUs = now;
+        PollResponse();
+    }
+    else
+    {
+        iDeadlineUs = now + ShtMeasurementTimeUs( iRepeat );
+    }
+}
+
+void ShtSensor::PollResponse()
+{
+    ShtDataResponse response;
+
+    if ( ReadResponse( response ) )
+    {
+        iState = eIdle;
+        ProcessResponse( response );
+        return;
+    }
+
+    if ( IsDue( iTimeoutUs ) )
+    {
+        iState = eIdle;
+        iStats.iTimeouts++;
+        iErrorCode = ShtSensorErr::eNotResponding;
+
+        // SHT sensor did not respond within 20 ms
+        Serial.print( "SHT sensor did not respond within 20ms!\n" );
+        return;
+    }
+
+    // Result late, try again in a while instead of spinning on the bus
+    iDeadlineUs = micros() + SHT_POLL_INTERVAL_US;
+}
+
+void ShtSensor::UpdatePeriodic()
+{
+    if ( ( millis() - iLastCmdTime ) < iFetchDelayMs )
+    {
+        return;
+    }
+
+    FetchDataCmd fetch_cmd;
+    ShtDataResponse response;
+
+    iLastCmdTime = millis();
+
+    if ( SendCommand( fetch_cmd ) && ReadResponse( response ) )
+    {
+        iLastDataTime = iLastCmdTime;
+        iFetchDelayMs = iPeriodMs;
+
+        ProcessResponse( response );
+        return;
+    }
+
+    // Result not ready yet, try again shortly
+    iFetchDelayMs = SHT_FETCH_RETRY_MS;
+
+    if ( ( iLastCmdTime - iLastDataTime ) > ( iPeriodMs + SHT_RESPONSE_TIMEOUT_MS ) )
+    {
+        iStats.iTimeouts++;
+        iErrorCode = ShtSensorErr::eNotResponding;
+    }
 }
 
 void ShtSensor::ProcessResponse( ShtDataResponse &aResponse )
 {
+    const uint8_t valid = aResponse.Validate();
+
     // Process temperature 
-    if ( aResponse.IsTempValid() )
+    if ( valid & ShtDataResponse::eTempCrcOk )
     {
-        iTemp = -45 + 175.0 * ( aResponse.GetRawTemp() / 65535.0 );
+        iTempCenti = aResponse.GetTempCenti();
     }
     else
     {
+        iStats.iCrcErrors++;
         Serial.print( "Invalid Temperature packet received!\n" );
         // TODO: Tmeperature packet is invalid
     }
     
     // Process humidity
-    if ( aResponse.IsHumValid() )
+    if ( valid & ShtDataResponse::eHumCrcOk )
     {
-        iHum = 100.0 * ( aResponse.GetRawHum() / 65535.0 );
+        iHumCenti = aResponse.GetHumCenti();
     }
     else
     {
+        iStats.iCrcErrors++;
         Serial.print( "Invalid Humidity packet received!\n" );
         // TODO: Humidity packet is invalid
     }
+
+    if ( valid == ( ShtDataResponse::eTempCrcOk | ShtDataResponse::eHumCrcOk ) )
+    {
+        iStats.iResults++;
+    }
 }
 
-void ShtSensor::Update()
+uint32_t ShtSensor::GetDeadlineUs() const
 {
-    enum TransmitMode
+    if ( iState == eWaitResponse )
     {
-        eTransmit,
-        eReceive
-    };
+        return iDeadlineUs;
+    }
 
-    static TransmitMode mode = eTransmit;
+    // Queued commands and back-to-back measurements are due right away
+    if ( ( iQueueCount != 0 ) || ( ( iPeriodMs == 0 ) && ( iShotIntervalMs == 0 ) ) )
+    {
+        return micros();
+    }
 
-    if ( mode == eTransmit )
+    // The next single shot measurement is due once its interval elapsed
+    if ( iPeriodMs == 0 )
     {
-        SingleShotCmd shot_cmd;
+        return (uint32_t)( ( iLastCmdTime + iShotIntervalMs ) * 1000 );
+    }
 
-        // If command was successfully sent
-        if ( SendCommand( shot_cmd ) )
-        {
-            // Store timestamp of sent command
-            iLastCmdTime = millis();
+    return (uint32_t)( ( iLastCmdTime + iFetchDelayMs ) * 1000 );
+}
 
-            // Command successfully sent, go to receive mode
-            mode = eReceive;
+void ShtSensor::Update()
+{
+    // Wait for the result of the measurement in progress
+    if ( iState == eWaitResponse )
+    {
+        if ( IsDue( iDeadlineUs ) )
+        {
+            PollResponse();
         }
+
+        return;
+    }
+
+    // Mode changes are sent between measurements
+    if ( iQueueCount != 0 )
+    {
+        SendQueued();
+        return;
+    }
+
+    // Sensor measures on its own in periodic mode
+    if ( iPeriodMs != 0 )
+    {
+        UpdatePeriodic();
     }
     else
     {
-        // If time to measure data by SHT sensor elapsed
-        if ( IsTimeToReceive() )
-        {
-            ShtDataResponse response;
-
-            if ( ReceiveResponse( response, SHT_RESPONSE_TIMEOUT_MS ) )
-            {
-                // Response from SHT sensor received so set error code to eNoError
-                iErrorCode = ShtSensorErr::eNoError;
-
-                // Process received response
-                ProcessResponse( response );
-            }
-            else
-            {
-                iErrorCode = ShtSensorErr::eNotResponding;
-
-                // SHT sensor did not respond within 20 ms
-                Serial.print( "SHT sensor did not respond within 20ms!\n" );
-            }
-            
-            mode = eTransmit;    
-        }
+        StartMeasurement();
     }
-}
\ No newline at end of file
+}
@@ -3,7 +3,9 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <Wire.h>
 #include "ShtCommand.h"
+#include "I2cBusManager.h"
 
 /**
  *  Default address of a SHT sensor
@@ -16,14 +18,29 @@
 #define SHT_I2C_FREQUENCY_HZ    600000
 
 /**
- *  Time needed for measuring data by SHT sensor in milliseconds
+ *  Timeout for SHT sensor to respond on a command in milliseconds
  */
-#define SHT_RESPONSE_TIME_MS    15
+#define SHT_RESPONSE_TIMEOUT_MS 20
 
 /**
- *  Timeout for SHT sensor to respond on a command in milliseconds
+ *  Time between two periodic measurements in ART mode in milliseconds
  */
-#define SHT_RESPONSE_TIMEOUT_MS 20
+#define SHT_ART_PERIOD_MS       250
+
+/**
+ *  Delay before fetching again when periodic result was not ready in milliseconds
+ */
+#define SHT_FETCH_RETRY_MS      2
+
+/**
+ *  Interval of polling a single shot result which was not ready in time in microseconds
+ */
+#define SHT_POLL_INTERVAL_US    500
+
+/**
+ *  Number of commands waiting to be sent to SHT sensor
+ */
+#define SHT_CMD_QUEUE_SIZE      4
 
 /**
  *  Invalid value of temperature
@@ -44,33 +61,145 @@ enum ShtSensorErr
     eNotResponding
 };
 
-class ShtSensor: public TwoWire
+/**
+ *  Counters of I2C transactions and errors of SHT sensor
+ */
+struct ShtSensorStats
+{
+    /**
+     * Commands acknowledged by the sensor
+    */
+    uint32_t iCommands;
+
+    /**
+     * Commands not acknowledged by the sensor
+    */
+    uint32_t iBusErrors;
+
+    /**
+     * Reads rejected because a result was not ready yet
+    */
+    uint32_t iNotReady;
+
+    /**
+     * Measurements with no result until timeout
+    */
+    uint32_t iTimeouts;
+
+    /**
+     * Responses with invalid temperature or humidity CRC
+    */
+    uint32_t iCrcErrors;
+
+    /**
+     * Responses with both temperature and humidity valid
+    */
+    uint32_t iResults;
+};
+
+class ShtSensor: public I2cDriver
 {
+    /**
+     * Controller of the I2C bus SHT sensor is connected to, shared with other drivers
+    */
+    TwoWire &iWire;
+
     /** 
      * An address of SHT sensor connected on the I2C bus
     */
     uint8_t iAddr;
 
     /**
-     * Computed temperature received from a SHT sensor
+     * Computed temperature received from a SHT sensor in 0.01 degC
     */
-    float iTemp;
+    int16_t iTempCenti;
 
     /**
-     * Computed humidity received from a SHT sensor
+     * Computed humidity received from a SHT sensor in 0.01 %RH
     */
-    float iHum;
+    uint16_t iHumCenti;
 
     /**
      * Timestamp of the last command sent to SHT sensor
     */
     uint64_t iLastCmdTime;
 
+    /**
+     * Enum representing state of the transaction in progress
+    */
+    enum TransactionState : uint8_t
+    {
+        eIdle,
+        eWaitResponse
+    };
+
+    /**
+     * Command waiting to be sent and the mode it switches SHT sensor to
+    */
+    struct QueuedCmd
+    {
+        uint8_t iMSB;
+        uint8_t iLSB;
+
+        /**
+         * Period of acquisition started by the command, zero for single shot mode
+        */
+        uint16_t iPeriodMs;
+
+        /**
+         * Time of the first measurement of started acquisition
+        */
+        uint16_t iMeasTimeUs;
+    };
+
+    TransactionState iState;
+
+    /**
+     * Time of the next read attempt and time to give up waiting, micros()
+    */
+    uint32_t iDeadlineUs;
+    uint32_t iTimeoutUs;
+
+    /**
+     * Commands to be sent before the next measurement
+    */
+    QueuedCmd iQueue[SHT_CMD_QUEUE_SIZE];
+    uint8_t iQueueHead;
+    uint8_t iQueueCount;
+
+    ShtSensorStats iStats;
+
+    /**
+     * Repeatability and clock stretching of single shot measurements
+    */
+    ShtRepeatability iRepeat;
+    SingleShotCmd::ClkStretching iClkStretch;
+
     /**
      * Error code for SHT sensor
     */
     ShtSensorErr iErrorCode;
 
+    /**
+     * Period of measurements in periodic mode, zero in single shot mode
+    */
+    uint32_t iPeriodMs;
+
+    /**
+     * Minimal time between two single shot measurements, zero for back-to-back
+    */
+    uint32_t iShotIntervalMs;
+
+    /**
+     * Delay of the next fetch after the last command in periodic mode
+    */
+    uint32_t iFetchDelayMs;
+
+    /**
+     * Timestamp of the last result fetched in periodic mode
+    */
+    uint64_t iLastDataTime;
+
     /**
      * Flushes internal buffers to prepare I2C interface for receiving data from SHT sensor 
      * 
@@ -87,22 +216,52 @@ class ShtSensor: public TwoWire
     bool SendCommand( ShtCmdBase &aCmd );
 
     /** 
-     * Receives a response on a previous command
+     * Reads a response once, without waiting for the sensor
      * 
      * @param aResponse received response
-     * @param aTimeout timeout in millisencods to receive a response
-     * @return Receive success within passed-in timeout
+     * @return True if the sensor had a result ready
+    */
+    bool ReadResponse( ShtDataResponse &aResponse );
+
+    /** 
+     * Queues a command switching the acquisition mode of SHT sensor
+     * 
+     * @param aCmd command to be queued
+     * @param aPeriodMs period of started acquisition, zero for single shot mode
+     * @param aRepeat repeatability of started acquisition
+     * @return False if the queue is full
+    */
+    bool QueueCommand( ShtCmdBase &aCmd, const uint16_t aPeriodMs, const ShtRepeatability aRepeat );
+
+    /** 
+     * Sends the oldest queued command and applies its mode once acknowledged
+    */
+    void SendQueued();
+
+    /** 
+     * Sends a single shot command and schedules reading of its result
+    */
+    void StartMeasurement();
+
+    /** 
+     * Tries to read a single shot result once its deadline passed
     */
-    bool ReceiveResponse( ShtDataResponse &aResponse, const uint8_t aTimeout );
+    void PollResponse();
 
     /** 
-     * Detects if SHT sensor is ready to send measured data
+     * Fetches the latest result of periodic data acquisition once a period
+    */
+    void UpdatePeriodic();
+
+    /** 
+     * Detects if a deadline passed, safe over micros() wrap-around
      * 
-     * @return True if it is time to receive measured data
+     * @param aDeadlineUs deadline, micros()
+     * @return True if deadline passed
     */
-    bool IsTimeToReceive() const
+    static bool IsDue( const uint32_t aDeadlineUs )
     {
-        return ( millis() - iLastCmdTime ) > SHT_RESPONSE_TIME_MS;
+        return (int32_t)( micros() - aDeadlineUs ) >= 0;
     }
 
     /** 
@@ -117,26 +276,174 @@ class ShtSensor: public TwoWire
 
     public:
         /**
-         * Constructor to initialize I2C interface and flush internal buffers
+         * Constructor of SHT sensor driver on a shared I2C bus
          * 
-         * @param aSDA SDA I2C pin number SHT sensor is connected to
-         * @param aSCL SCL I2C pin number SHT sensor is connected to
+         * @param aWire controller of the I2C bus, see I2cBusManager::GetWire()
          * @param aAddr I2C address of SHT sensor on I2C bus 
         */    
-        ShtSensor( const uint8_t aSDA, const uint8_t aSCL, const uint8_t aAddr = SHT_I2C_DEFAULT_ADDR ): 
-            TwoWire( 0 ), 
-            iAddr( aAddr )
+        ShtSensor( TwoWire &aWire, const uint8_t aAddr = SHT_I2C_DEFAULT_ADDR ): 
+            iWire( aWire ), 
+            iAddr( aAddr ),
+            iTempCenti( 0 ),
+            iHumCenti( 0 ),
+            iLastCmdTime( 0 ),
+            iState( eIdle ),
+            iDeadlineUs( 0 ),
+            iTimeoutUs( 0 ),
+            iQueueHead( 0 ),
+            iQueueCount( 0 ),
+            iStats{},
+            iRepeat( eRepeatHigh ),
+            iClkStretch( SingleShotCmd::eDisabled ),
+            iErrorCode( ShtSensorErr::eNotResponding ),
+            iPeriodMs( 0 ),
+            iShotIntervalMs( 0 ),
+            iFetchDelayMs( 0 ),
+            iLastDataTime( 0 )
         {
-            begin( aSDA, aSCL, aAddr );
-            setClock( SHT_I2C_FREQUENCY_HZ );
-            flush();
         }
 
         /**
          * Updates temperature and humudity values from SHT sensor  
+         * 
+         * Performs at most one step of the transaction in progress and never
+         * waits for the sensor, unless clock stretching is enabled.
         */
         void Update();
 
+        void Step() override
+        {
+            Update();
+        }
+
+        /**
+         * Returns time SHT sensor needs the bus next
+         * 
+         * @return deadline of the next Update() step, micros()
+        */
+        uint32_t GetDeadlineUs() const override;
+
+        /**
+         * Selects repeatability and clock stretching of single shot measurements
+         * 
+         * Lower repeatability is noisier but measures about 3x faster than high.
+         * With clock stretching Update() blocks on the bus for the whole
+         * measurement and returns fresh data in a single call.
+         * 
+         * @param aRepeat repeatability of measurements
+         * @param aClkStretch clock stretching support
+        */
+        void SetMode( ShtRepeatability aRepeat, SingleShotCmd::ClkStretching aClkStretch = SingleShotCmd::eDisabled )
+        {
+            iRepeat = aRepeat;
+            iClkStretch = aClkStretch;
+        }
+
+        /**
+         * Sets time between two single shot measurements
+         * 
+         * The sensor idles between measurements, which saves the bus, power and
+         * self-heating of the sensor. Periodic mode keeps its own rate.
+         * 
+         * @param aIntervalMs time from one measurement to the next, zero for back-to-back
+        */
+        void SetShotInterval( const uint32_t aIntervalMs )
+        {
+            iShotIntervalMs = aIntervalMs;
+        }
+
+        /**
+         * Returns time between two measurements in the current mode
+         * 
+         * @return period of periodic mode or interval of single shot measurements
+        */
+        uint32_t GetIntervalMs() const
+        {
+            return ( iPeriodMs != 0 ) ? iPeriodMs : iShotIntervalMs;
+        }
+
+        /**
+         * Switches SHT sensor to periodic data acquisition, Update() then only
+         * fetches the latest result instead of triggering a measurement
+         * 
+         * The command is sent by Update() once the transaction in progress ends.
+         * 
+         * @param aRate measurements per second
+         * @param aRepeat repeatability of measurements
+         * @return False if the command queue is full
+        */
+        bool StartPeriodic( PeriodicCmd::Rate aRate, ShtRepeatability aRepeat = eRepeatHigh )
+        {
+            PeriodicCmd periodic_cmd( aRate, aRepeat );
+
+            return QueueCommand( periodic_cmd, PeriodicCmd::GetPeriodMs( aRate ), aRepeat );
+        }
+
+        /**
+         * Switches SHT sensor to periodic data acquisition with accelerated response time
+         * 
+         * @return False if the command queue is full
+        */
+        bool StartArt()
+        {
+            ArtCmd art_cmd;
+
+            return QueueCommand( art_cmd, SHT_ART_PERIOD_MS, eRepeatHigh );
+        }
+
+        /**
+         * Stops periodic data acquisition and returns to single shot mode
+         * 
+         * @return False if the command queue is full
+        */
+        bool StopPeriodic()
+        {
+            BreakCmd break_cmd;
+
+            return QueueCommand( break_cmd, 0, eRepeatHigh );
+        }
+
+        const ShtSensorStats& GetStats() const
+        {
+            return iStats;
+        }
+
+        /**
+         * Returns true if SHT sensor runs periodic data acquisition
+        */
+        bool IsPeriodic() const
+        {
+            return iPeriodMs != 0;
+        }
+
+        /**
+         * Returns true if the last computed values are valid
+        */
+        bool IsValid() const
+        {
+            return iErrorCode == ShtSensorErr::eNoError;
+        }
+
+        /**
+         * Returns the last computed temperature from SHT sensor, check IsValid() first
+         * 
+         * @return value of temperature in 0.01 degC
+        */
+        int16_t GetTemperatureCenti() const
+        {
+            return iTempCenti;
+        }
+
+        /**
+         * Returns the last computed humidity from SHT sensor, check IsValid() first
+         * 
+         * @return value of humidity in 0.01 %RH
+        */
+        uint16_t GetHumidityCenti() const
+        {
+            return iHumCenti;
+        }
+
         /**
          * Returns the last computed temperature from SHT sensor
          * 
@@ -144,7 +451,7 @@ class ShtSensor: public TwoWire
         */
         float GetTemperature() const
         {
-            return ( iErrorCode == ShtSensorErr::eNoError ) ? iTemp : INVALID_TEMPERATURE;
+            return IsValid() ? iTempCenti / 100.0f : INVALID_TEMPERATURE;
         }
 
         /**
@@ -154,7 +461,7 @@ class ShtSensor: public TwoWire
         */
         float GetHumidity() const
         {
-            return ( iErrorCode == ShtSensorErr::eNoError ) ? iHum : INVALID_HUMIDITY;
+            return IsValid() ? iHumCenti / 100.0f : INVALID_HUMIDITY;
         }
 };
 
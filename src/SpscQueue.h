@@ -0,0 +1,133 @@
+#ifndef __SPSC_QUEUE_H__
+#define __SPSC_QUEUE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <atomic>
+
+/**
+ * Forces inlining, so a push called from an IRAM function stays in IRAM
+ */
+#define SPSC_ALWAYS_INLINE  inline __attribute__( ( always_inline ) )
+
+/**
+ * Fixed-capacity lock-free single-producer/single-consumer ring buffer
+ *
+ * Push() may be called from an ISR and Pop() from the main loop, or both from
+ * two tasks, as long as there is only one producer context and only one
+ * consumer context. The producer owns the tail index and the consumer owns the
+ * head index; each publishes its index with release ordering after touching the
+ * slot, so no locks or disabled interrupts are needed. Nothing is allocated.
+ *
+ * @tparam T type of queued element, copied in and out
+ * @tparam N capacity, must be a power of two
+ */
+template<typename T, uint32_t N>
+class SpscQueue
+{
+    static_assert( ( N >= 2 ) && ( ( N & ( N - 1 ) ) == 0 ), "Capacity must be a power of two" );
+
+    /**
+     * Storage of elements, indexes run freely and are masked on access
+    */
+    T iSlots[N];
+
+    /**
+     * Index of the next element to pop, written only by consumer
+    */
+    std::atomic<uint32_t> iHead;
+
+    /**
+     * Index of the next free slot, written only by producer
+    */
+    std::atomic<uint32_t> iTail;
+
+    /**
+     * Number of elements rejected because the queue was full, written only by producer
+    */
+    std::atomic<uint32_t> iOverflows;
+
+    /**
+     * Highest number of queued elements seen by producer
+    */
+    std::atomic<uint32_t> iHighWater;
+
+    public:
+        SpscQueue(): iHead( 0 ), iTail( 0 ), iOverflows( 0 ), iHighWater( 0 )
+        {
+        }
+
+        /**
+         * Appends an element, producer side
+         *
+         * @param aItem element to append
+         * @return False if queue is full, the element is dropped and counted
+        */
+        SPSC_ALWAYS_INLINE bool Push( const T &aItem )
+        {
+            const uint32_t tail = iTail.load( std::memory_order_relaxed );
+            const uint32_t used = tail - iHead.load( std::memory_order_acquire );
+
+            if ( used >= N )
+            {
+                iOverflows.store( iOverflows.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+                return false;
+            }
+
+            iSlots[tail & ( N - 1 )] = aItem;
+            iTail.store( tail + 1, std::memory_order_release );
+
+            if ( used + 1 > iHighWater.load( std::memory_order_relaxed ) )
+            {
+                iHighWater.store( used + 1, std::memory_order_relaxed );
+            }
+
+            return true;
+        }
+
+        /**
+         * Takes the oldest element, consumer side
+         *
+         * @param aItem taken element
+         * @return False if queue is empty
+        */
+        SPSC_ALWAYS_INLINE bool Pop( T &aItem )
+        {
+            const uint32_t head = iHead.load( std::memory_order_relaxed );
+
+            if ( head == iTail.load( std::memory_order_acquire ) )
+            {
+                return false;
+            }
+
+            aItem = iSlots[head & ( N - 1 )];
+            iHead.store( head + 1, std::memory_order_release );
+
+            return true;
+        }
+
+        /**
+         * Returns number of queued elements, exact only when called by one of the sides
+        */
+        uint32_t GetCount() const
+        {
+            return iTail.load( std::memory_order_acquire ) - iHead.load( std::memory_order_acquire );
+        }
+
+        static constexpr uint32_t GetCapacity()
+        {
+            return N;
+        }
+
+        uint32_t GetOverflows() const
+        {
+            return iOverflows.load( std::memory_order_relaxed );
+        }
+
+        uint32_t GetHighWater() const
+        {
+            return iHighWater.load( std::memory_order_relaxed );
+        }
+};
+
+#endif /* __SPSC_QUEUE_H__ */
@@ -0,0 +1,185 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "TelemetryCodec.h"
+
+int16_t TelemetryCodec::TempToCenti( const float aTemp )
+{
+    const float centi = aTemp * 100.0f;
+
+    if ( centi >= INT16_MAX )
+    {
+        return INT16_MAX;
+    }
+
+    if ( centi <= INT16_MIN )
+    {
+        return INT16_MIN;
+    }
+
+    // Round half away from zero
+    return (int16_t)( ( centi < 0 ) ? centi - 0.5f : centi + 0.5f );
+}
+
+uint16_t TelemetryCodec::HumToCenti( const float aHum )
+{
+    const float centi = aHum * 100.0f;
+
+    if ( centi >= UINT16_MAX )
+    {
+        return UINT16_MAX;
+    }
+
+    if ( centi <= 0 )
+    {
+        return 0;
+    }
+
+    return (uint16_t)( centi + 0.5f );
+}
+
+size_t TelemetryCodec::FormatCenti( const int32_t aCenti, char *aBuff, const size_t aSize )
+{
+    const uint32_t magnitude = ( aCenti < 0 ) ? 0 - (uint32_t) aCenti : (uint32_t) aCenti;
+    const int written = snprintf( aBuff, aSize, "%s%u.%02u", ( aCenti < 0 ) ? "-" : "",
+                                  (unsigned)( magnitude / 100 ), (unsigned)( magnitude % 100 ) );
+
+    return ( ( written < 0 ) || ( (size_t) written >= aSize ) ) ? 0 : (size_t) written;
+}
+
+size_t TelemetryCodec::Encode( const TelemetryRecord &aRecord, uint8_t *aBuff, const size_t aSize )
+{
+    if ( aSize < TELEMETRY_FRAME_SIZE )
+    {
+        return 0;
+    }
+
+    const uint16_t temp = (uint16_t) aRecord.iTempCenti;
+
+    aBuff[0] = TELEMETRY_SCHEMA_VERSION;
+    aBuff[1] = ( aRecord.iMovement ? eMovement : 0 ) |
+               ( aRecord.iTempValid ? eTempValid : 0 ) |
+               ( aRecord.iHumValid ? eHumValid : 0 );
+    aBuff[2] = temp & 0xFF;
+    aBuff[3] = temp >> 8;
+    aBuff[4] = aRecord.iHumCenti & 0xFF;
+    aBuff[5] = aRecord.iHumCenti >> 8;
+    aBuff[6] = (uint8_t) aRecord.iRssi;
+    aBuff[7] = aRecord.iVersionMajor;
+    aBuff[8] = aRecord.iVersionMinor;
+    aBuff[9] = aRecord.iOfflineMs & 0xFF;
+    aBuff[10] = ( aRecord.iOfflineMs >> 8 ) & 0xFF;
+    aBuff[11] = ( aRecord.iOfflineMs >> 16 ) & 0xFF;
+    aBuff[12] = aRecord.iOfflineMs >> 24;
+
+    return TELEMETRY_FRAME_SIZE;
+}
+
+bool TelemetryCodec::Decode( const uint8_t *aBuff, const size_t aSize, TelemetryRecord &aRecord )
+{
+    if ( ( aSize != TELEMETRY_FRAME_SIZE ) || ( aBuff[0] != TELEMETRY_SCHEMA_VERSION ) )
+    {
+        return false;
+    }
+
+    aRecord.iMovement = aBuff[1] & eMovement;
+    aRecord.iTempValid = aBuff[1] & eTempValid;
+    aRecord.iHumValid = aBuff[1] & eHumValid;
+    aRecord.iTempCenti = (int16_t)( aBuff[2] | aBuff[3] << 8 );
+    aRecord.iHumCenti = (uint16_t)( aBuff[4] | aBuff[5] << 8 );
+    aRecord.iRssi = (int8_t) aBuff[6];
+    aRecord.iVersionMajor = aBuff[7];
+    aRecord.iVersionMinor = aBuff[8];
+    aRecord.iOfflineMs = (uint32_t) aBuff[9] |
+                         (uint32_t) aBuff[10] << 8 |
+                         (uint32_t) aBuff[11] << 16 |
+                         (uint32_t) aBuff[12] << 24;
+
+    return true;
+}
+
+size_t TelemetryCodec::EncodeBatch( const TelemetrySample aSamples[], const uint8_t aCount,
+                                    const uint8_t aVersionMajor, const uint8_t aVersionMinor,
+                                    uint8_t *aBuff, const size_t aSize )
+{
+    if ( ( aCount == 0 ) || ( aSize < GetBatchSize( aCount ) ) )
+    {
+        return 0;
+    }
+
+    const uint32_t first = aSamples[0].iTimestamp;
+
+    aBuff[0] = TELEMETRY_BATCH_SCHEMA_VERSION;
+    aBuff[1] = aCount;
+    aBuff[2] = aVersionMajor;
+    aBuff[3] = aVersionMinor;
+    aBuff[4] = first & 0xFF;
+    aBuff[5] = ( first >> 8 ) & 0xFF;
+    aBuff[6] = ( first >> 16 ) & 0xFF;
+    aBuff[7] = first >> 24;
+
+    uint8_t *out = &aBuff[TELEMETRY_BATCH_HEADER_SIZE];
+    uint32_t previous = first;
+
+    for ( uint8_t idx = 0; idx < aCount; ++idx, out += TELEMETRY_BATCH_SAMPLE_SIZE )
+    {
+        const TelemetrySample &sample = aSamples[idx];
+        const uint32_t elapsed = sample.iTimestamp - previous;
+        const uint16_t delta = ( elapsed > UINT16_MAX ) ? UINT16_MAX : elapsed;
+        const uint16_t temp = (uint16_t) sample.iTempCenti;
+
+        out[0] = delta & 0xFF;
+        out[1] = delta >> 8;
+        out[2] = ( sample.iMovement ? eMovement : 0 ) |
+                 ( sample.iTempValid ? eTempValid : 0 ) |
+                 ( sample.iHumValid ? eHumValid : 0 );
+        out[3] = (uint8_t) sample.iRssi;
+        out[4] = temp & 0xFF;
+        out[5] = temp >> 8;
+        out[6] = sample.iHumCenti & 0xFF;
+        out[7] = sample.iHumCenti >> 8;
+
+        previous = sample.iTimestamp;
+    }
+
+    return GetBatchSize( aCount );
+}
+
+uint8_t TelemetryCodec::DecodeBatch( const uint8_t *aBuff, const size_t aSize,
+                                     TelemetrySample aSamples[], const uint8_t aMaxCount )
+{
+    if ( ( aSize < TELEMETRY_BATCH_HEADER_SIZE ) || ( aBuff[0] != TELEMETRY_BATCH_SCHEMA_VERSION ) )
+    {
+        return 0;
+    }
+
+    const uint8_t count = aBuff[1];
+
+    if ( ( count > aMaxCount ) || ( aSize != GetBatchSize( count ) ) )
+    {
+        return 0;
+    }
+
+    const uint8_t *in = &aBuff[TELEMETRY_BATCH_HEADER_SIZE];
+    uint32_t timestamp = (uint32_t) aBuff[4] |
+                         (uint32_t) aBuff[5] << 8 |
+                         (uint32_t) aBuff[6] << 16 |
+                         (uint32_t) aBuff[7] << 24;
+
+    for ( uint8_t idx = 0; idx < count; ++idx, in += TELEMETRY_BATCH_SAMPLE_SIZE )
+    {
+        TelemetrySample &sample = aSamples[idx];
+
+        timestamp += (uint16_t)( in[0] | in[1] << 8 );
+
+        sample.iTimestamp = timestamp;
+        sample.iMovement = in[2] & eMovement;
+        sample.iTempValid = in[2] & eTempValid;
+        sample.iHumValid = in[2] & eHumValid;
+        sample.iRssi = (int8_t) in[3];
+        sample.iTempCenti = (int16_t)( in[4] | in[5] << 8 );
+        sample.iHumCenti = (uint16_t)( in[6] | in[7] << 8 );
+    }
+
+    return count;
+}
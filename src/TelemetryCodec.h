@@ -0,0 +1,213 @@
+#ifndef __TELEMETRY_CODEC_H__
+#define __TELEMETRY_CODEC_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Schema version of the binary telemetry frame, first byte of every frame
+ */
+#define TELEMETRY_SCHEMA_VERSION    1
+
+/**
+ * Size of encoded telemetry frame in bytes
+ */
+#define TELEMETRY_FRAME_SIZE        13
+
+/**
+ * Schema version of the binary batch frame
+ */
+#define TELEMETRY_BATCH_SCHEMA_VERSION  2
+
+/**
+ * Size of batch frame header and of one sample in a batch frame in bytes
+ */
+#define TELEMETRY_BATCH_HEADER_SIZE     8
+#define TELEMETRY_BATCH_SAMPLE_SIZE     8
+
+/**
+ * One telemetry sample in fixed-point representation
+ */
+struct TelemetryRecord
+{
+    /**
+     * Temperature in hundredths of a degree Celsius
+    */
+    int16_t iTempCenti;
+
+    /**
+     * Relative humidity in hundredths of a percent
+    */
+    uint16_t iHumCenti;
+
+    bool iTempValid;
+    bool iHumValid;
+    bool iMovement;
+
+    /**
+     * Wi-Fi signal strength in dBm
+    */
+    int8_t iRssi;
+
+    /**
+     * Firmware version
+    */
+    uint8_t iVersionMajor;
+    uint8_t iVersionMinor;
+
+    /**
+     * Total time the device spent without broker connection in milliseconds
+    */
+    uint32_t iOfflineMs;
+};
+
+/**
+ * Timestamped sample buffered for a batch
+ */
+struct TelemetrySample
+{
+    /**
+     * Time the sample was taken at, millis()
+    */
+    uint32_t iTimestamp;
+
+    int16_t iTempCenti;
+    uint16_t iHumCenti;
+
+    bool iTempValid;
+    bool iHumValid;
+    bool iMovement;
+
+    int8_t iRssi;
+};
+
+/**
+ * Encoder and decoder of the binary telemetry frame
+ *
+ * Frame layout, multi-byte fields are little endian:
+ *
+ *  offset  size  field
+ *  0       1     schema version
+ *  1       1     flags: bit 0 movement, bit 1 temperature valid, bit 2 humidity valid
+ *  2       2     temperature, int16, 0.01 degC
+ *  4       2     humidity, uint16, 0.01 %RH
+ *  6       1     RSSI, int8, dBm
+ *  7       1     firmware version major
+ *  8       1     firmware version minor
+ *  9       4     offline time, uint32, ms
+ *
+ * Batch frame layout:
+ *
+ *  offset  size  field
+ *  0       1     schema version (2)
+ *  1       1     number of samples
+ *  2       1     firmware version major
+ *  3       1     firmware version minor
+ *  4       4     timestamp of the first sample, uint32, ms
+ *  8 + 8n  2     time since previous sample, uint16, ms, saturated
+ *  10 + 8n 1     flags, same bits as in the single frame
+ *  11 + 8n 1     RSSI, int8, dBm
+ *  12 + 8n 2     temperature, int16, 0.01 degC
+ *  14 + 8n 2     humidity, uint16, 0.01 %RH
+ */
+class TelemetryCodec
+{
+    public:
+        /**
+         * Enum representing bits of the flags byte
+        */
+        enum Flags : uint8_t
+        {
+            eMovement   = 0x01,
+            eTempValid  = 0x02,
+            eHumValid   = 0x04
+        };
+
+        /**
+         * Converts temperature to the fixed-point representation
+         *
+         * @param aTemp temperature in Celsius
+         * @return temperature in hundredths of a degree, saturated to int16
+        */
+        static int16_t TempToCenti( const float aTemp );
+
+        /**
+         * Converts humidity to the fixed-point representation
+         *
+         * @param aHum humidity in %
+         * @return humidity in hundredths of a percent, saturated to uint16
+        */
+        static uint16_t HumToCenti( const float aHum );
+
+        /**
+         * Formats a fixed-point value as a decimal number with two decimals,
+         * without any floating point math
+         *
+         * @param aCenti value in hundredths
+         * @param aBuff output buffer
+         * @param aSize size of output buffer
+         * @return Number of characters written, zero if buffer is too small
+        */
+        static size_t FormatCenti( const int32_t aCenti, char *aBuff, const size_t aSize );
+
+        /**
+         * Encodes a record into a binary frame
+         *
+         * @param aRecord record to encode
+         * @param aBuff output buffer
+         * @param aSize size of output buffer
+         * @return Number of bytes written, zero if buffer is too small
+        */
+        static size_t Encode( const TelemetryRecord &aRecord, uint8_t *aBuff, const size_t aSize );
+
+        /**
+         * Decodes a binary frame into a record
+         *
+         * @param aBuff received frame
+         * @param aSize size of received frame
+         * @param aRecord decoded record
+         * @return True if frame has a known schema version and correct size
+        */
+        static bool Decode( const uint8_t *aBuff, const size_t aSize, TelemetryRecord &aRecord );
+
+        /**
+         * Encodes samples into a binary batch frame
+         *
+         * @param aSamples samples ordered by time
+         * @param aCount number of samples
+         * @param aVersionMajor firmware version major
+         * @param aVersionMinor firmware version minor
+         * @param aBuff output buffer
+         * @param aSize size of output buffer
+         * @return Number of bytes written, zero if buffer is too small
+        */
+        static size_t EncodeBatch( const TelemetrySample aSamples[], const uint8_t aCount,
+                                   const uint8_t aVersionMajor, const uint8_t aVersionMinor,
+                                   uint8_t *aBuff, const size_t aSize );
+
+        /**
+         * Decodes a binary batch frame
+         *
+         * @param aBuff received frame
+         * @param aSize size of received frame
+         * @param aSamples decoded samples
+         * @param aMaxCount capacity of aSamples
+         * @return Number of decoded samples, zero if frame is malformed
+        */
+        static uint8_t DecodeBatch( const uint8_t *aBuff, const size_t aSize,
+                                    TelemetrySample aSamples[], const uint8_t aMaxCount );
+
+        /**
+         * Returns size of a batch frame
+         *
+         * @param aCount number of samples
+         * @return Size in bytes
+        */
+        static size_t GetBatchSize( const uint8_t aCount )
+        {
+            return TELEMETRY_BATCH_HEADER_SIZE + (size_t) aCount * TELEMETRY_BATCH_SAMPLE_SIZE;
+        }
+};
+
+#endif /* __TELEMETRY_CODEC_H__ */
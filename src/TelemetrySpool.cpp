@@ -0,0 +1,335 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <FS.h>
+#include "Crc8.h"
+#include "TelemetrySpool.h"
+
+typedef Crc8Table<SPOOL_CRC_POLYNOMIAL, SPOOL_CRC_INIT> SpoolCrc;
+
+void TelemetrySpool::MakePath( const uint8_t aSlot, char *aPath )
+{
+    snprintf( aPath, SPOOL_PATH_SIZE, "/spool/%u.bin", aSlot );
+}
+
+void TelemetrySpool::Encode( const SpoolRecord &aRecord, uint8_t *aBuff )
+{
+    aBuff[0] = aRecord.iSeq;
+    aBuff[1] = aRecord.iSeq >> 8;
+    aBuff[2] = aRecord.iSeq >> 16;
+    aBuff[3] = aRecord.iSeq >> 24;
+    aBuff[4] = aRecord.iTimestamp;
+    aBuff[5] = aRecord.iTimestamp >> 8;
+    aBuff[6] = aRecord.iTimestamp >> 16;
+    aBuff[7] = aRecord.iTimestamp >> 24;
+    aBuff[8] = aRecord.iBootId;
+    aBuff[9] = aRecord.iBootId >> 8;
+    aBuff[10] = (uint16_t) aRecord.iTempCenti;
+    aBuff[11] = (uint16_t) aRecord.iTempCenti >> 8;
+    aBuff[12] = aRecord.iHumCenti;
+    aBuff[13] = aRecord.iHumCenti >> 8;
+    aBuff[14] = aRecord.iFlags;
+    aBuff[15] = SpoolCrc::Compute( aBuff, SPOOL_RECORD_SIZE - 1 );
+}
+
+bool TelemetrySpool::Decode( const uint8_t *aBuff, SpoolRecord &aRecord )
+{
+    // CRC of data followed by its own CRC is zero
+    if ( SpoolCrc::Compute( aBuff, SPOOL_RECORD_SIZE ) != 0 )
+    {
+        return false;
+    }
+
+    aRecord.iSeq = aBuff[0] | ( aBuff[1] << 8 ) | ( aBuff[2] << 16 ) | ( (uint32_t) aBuff[3] << 24 );
+    aRecord.iTimestamp = aBuff[4] | ( aBuff[5] << 8 ) | ( aBuff[6] << 16 ) | ( (uint32_t) aBuff[7] << 24 );
+    aRecord.iBootId = aBuff[8] | ( aBuff[9] << 8 );
+    aRecord.iTempCenti = (int16_t)( aBuff[10] | ( aBuff[11] << 8 ) );
+    aRecord.iHumCenti = aBuff[12] | ( aBuff[13] << 8 );
+    aRecord.iFlags = aBuff[14];
+
+    return true;
+}
+
+bool TelemetrySpool::ReadEdge( fs::File &aFile, const uint16_t aRecords, const bool aLast, SpoolRecord &aRecord )
+{
+    uint8_t buff[SPOOL_RECORD_SIZE];
+
+    for ( uint16_t idx = 0; idx < aRecords; ++idx )
+    {
+        const uint16_t record = aLast ? aRecords - 1 - idx : idx;
+
+        if ( aFile.seek( (uint32_t) record * SPOOL_RECORD_SIZE ) &&
+             ( aFile.read( buff, SPOOL_RECORD_SIZE ) == SPOOL_RECORD_SIZE ) &&
+             Decode( buff, aRecord ) )
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+uint32_t TelemetrySpool::Begin( const uint16_t aBootId )
+{
+    uint16_t records[SPOOL_MAX_SEGMENTS];
+    uint32_t first_seq[SPOOL_MAX_SEGMENTS];
+    bool found[SPOOL_MAX_SEGMENTS];
+    bool any = false;
+    uint8_t head = 0;
+    char path[SPOOL_PATH_SIZE];
+    SpoolRecord record;
+
+    iBootId = aBootId;
+    iNextSeq = 0;
+    iHeadSlot = 0;
+    iSegments = 0;
+    iHeadRecords = 0;
+    iReadRecords = 0;
+    iTailRecords = 0;
+    iTailSealed = false;
+    iPending = 0;
+    iPeekRaw = 0;
+    iPeekCorrupt = 0;
+
+    for ( uint8_t slot = 0; slot < SPOOL_MAX_SEGMENTS; ++slot )
+    {
+        MakePath( slot, path );
+        found[slot] = false;
+
+        if ( !iFs.exists( path ) )
+        {
+            continue;
+        }
+
+        fs::File file = iFs.open( path, FILE_READ );
+        records[slot] = file ? file.size() / SPOOL_RECORD_SIZE : 0;
+        found[slot] = ReadEdge( file, records[slot], false, record );
+        file.close();
+
+        if ( !found[slot] )
+        {
+            // Nothing to replay from a segment without a single valid record
+            iFs.remove( path );
+            continue;
+        }
+
+        first_seq[slot] = record.iSeq;
+
+        if ( !any || ( (int32_t)( record.iSeq - first_seq[head] ) < 0 ) )
+        {
+            head = slot;
+        }
+
+        any = true;
+    }
+
+    if ( !any )
+    {
+        return 0;
+    }
+
+    // Segments follow the oldest one in the ring
+    iHeadSlot = head;
+
+    while ( ( iSegments < SPOOL_MAX_SEGMENTS ) && found[( head + iSegments ) % SPOOL_MAX_SEGMENTS] )
+    {
+        iPending += records[( head + iSegments ) % SPOOL_MAX_SEGMENTS];
+        iSegments++;
+    }
+
+    // Segments out of the ring order were never written by this class
+    for ( uint8_t slot = iSegments; slot < SPOOL_MAX_SEGMENTS; ++slot )
+    {
+        if ( found[( head + slot ) % SPOOL_MAX_SEGMENTS] )
+        {
+            MakePath( ( head + slot ) % SPOOL_MAX_SEGMENTS, path );
+            iFs.remove( path );
+        }
+    }
+
+    const uint8_t tail = ( head + iSegments - 1 ) % SPOOL_MAX_SEGMENTS;
+    MakePath( tail, path );
+
+    fs::File file = iFs.open( path, FILE_READ );
+    ReadEdge( file, records[tail], true, record );
+
+    iNextSeq = record.iSeq + 1;
+    iHeadRecords = records[head];
+    iTailRecords = records[tail];
+
+    // A record cut short by a power loss is not appended to
+    iTailSealed = ( file.size() % SPOOL_RECORD_SIZE ) != 0;
+    file.close();
+
+    return iPending;
+}
+
+void TelemetrySpool::RemoveHead()
+{
+    char path[SPOOL_PATH_SIZE];
+    const uint16_t records = ( iSegments == 1 ) ? iTailRecords : iHeadRecords;
+
+    if ( records > iReadRecords )
+    {
+        iStats.iDropped += records - iReadRecords;
+        iPending -= records - iReadRecords;
+    }
+
+    MakePath( iHeadSlot, path );
+    iFs.remove( path );
+
+    iHeadSlot = ( iHeadSlot + 1 ) % SPOOL_MAX_SEGMENTS;
+    iSegments--;
+    iReadRecords = 0;
+    iPeekRaw = 0;
+    iPeekCorrupt = 0;
+
+    if ( iSegments == 0 )
+    {
+        iHeadRecords = 0;
+        iTailRecords = 0;
+        iTailSealed = false;
+        return;
+    }
+
+    MakePath( iHeadSlot, path );
+    fs::File file = iFs.open( path, FILE_READ );
+    iHeadRecords = file ? file.size() / SPOOL_RECORD_SIZE : 0;
+    file.close();
+}
+
+bool TelemetrySpool::Push( const TelemetrySample &aSample )
+{
+    char path[SPOOL_PATH_SIZE];
+    uint8_t buff[SPOOL_RECORD_SIZE];
+
+    if ( ( iSegments == 0 ) || iTailSealed || ( iTailRecords >= SPOOL_SEGMENT_RECORDS ) )
+    {
+        if ( iSegments == SPOOL_MAX_SEGMENTS )
+        {
+            RemoveHead();
+        }
+
+        if ( iSegments == 1 )
+        {
+            // The only segment stops being the tail
+            iHeadRecords = iTailRecords;
+        }
+
+        iSegments++;
+        iTailRecords = 0;
+        iTailSealed = false;
+    }
+
+    SpoolRecord record;
+    record.iSeq = iNextSeq;
+    record.iTimestamp = aSample.iTimestamp;
+    record.iBootId = iBootId;
+    record.iTempCenti = aSample.iTempCenti;
+    record.iHumCenti = aSample.iHumCenti;
+    record.iFlags = ( aSample.iMovement ? TelemetryCodec::eMovement : 0 ) |
+                    ( aSample.iTempValid ? TelemetryCodec::eTempValid : 0 ) |
+                    ( aSample.iHumValid ? TelemetryCodec::eHumValid : 0 );
+    Encode( record, buff );
+
+    MakePath( ( iHeadSlot + iSegments - 1 ) % SPOOL_MAX_SEGMENTS, path );
+
+    // A new segment truncates whatever the slot held before
+    fs::File file = iFs.open( path, ( iTailRecords == 0 ) ? FILE_WRITE : FILE_APPEND );
+    const size_t written = file ? file.write( buff, SPOOL_RECORD_SIZE ) : 0;
+    file.close();
+
+    if ( written != SPOOL_RECORD_SIZE )
+    {
+        iStats.iWriteErrors++;
+        iStats.iDropped++;
+
+        if ( iTailRecords == 0 )
+        {
+            iFs.remove( path );
+            iSegments--;
+        }
+        else
+        {
+            // A partial record is ignored when read, the next sample starts a new segment
+            iTailSealed = true;
+        }
+
+        return false;
+    }
+
+    iNextSeq++;
+    iTailRecords++;
+    iPending++;
+    iStats.iSpooled++;
+
+    return true;
+}
+
+uint8_t TelemetrySpool::Peek( SpoolRecord aRecords[], const uint8_t aMax )
+{
+    char path[SPOOL_PATH_SIZE];
+    uint8_t buff[SPOOL_RECORD_SIZE];
+    uint8_t count = 0;
+
+    iPeekRaw = 0;
+    iPeekCorrupt = 0;
+
+    if ( iSegments == 0 )
+    {
+        return 0;
+    }
+
+    const uint16_t records = ( iSegments == 1 ) ? iTailRecords : iHeadRecords;
+
+    MakePath( iHeadSlot, path );
+    fs::File file = iFs.open( path, FILE_READ );
+
+    if ( file && file.seek( (uint32_t) iReadRecords * SPOOL_RECORD_SIZE ) )
+    {
+        while ( ( iPeekRaw < aMax ) && ( iReadRecords + iPeekRaw < records ) &&
+                ( file.read( buff, SPOOL_RECORD_SIZE ) == SPOOL_RECORD_SIZE ) )
+        {
+            iPeekRaw++;
+
+            if ( Decode( buff, aRecords[count] ) )
+            {
+                count++;
+            }
+            else
+            {
+                iPeekCorrupt++;
+            }
+        }
+    }
+
+    file.close();
+
+    // A segment which cannot be read any more would block the replay for good
+    if ( ( iPeekRaw == 0 ) && ( aMax != 0 ) )
+    {
+        RemoveHead();
+    }
+
+    return count;
+}
+
+void TelemetrySpool::Commit()
+{
+    if ( iPeekRaw == 0 )
+    {
+        return;
+    }
+
+    iReadRecords += iPeekRaw;
+    iPending -= iPeekRaw;
+    iStats.iReplayed += iPeekRaw - iPeekCorrupt;
+    iStats.iCorrupt += iPeekCorrupt;
+    iPeekRaw = 0;
+    iPeekCorrupt = 0;
+
+    if ( iReadRecords >= ( ( iSegments == 1 ) ? iTailRecords : iHeadRecords ) )
+    {
+        RemoveHead();
+    }
+}
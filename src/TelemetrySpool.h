@@ -0,0 +1,222 @@
+#ifndef __TELEMETRY_SPOOL_H__
+#define __TELEMETRY_SPOOL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <FS.h>
+#include "TelemetryCodec.h"
+
+/**
+ * Size of a stored record in bytes
+ */
+#define SPOOL_RECORD_SIZE       16
+
+/**
+ * Records per segment file, 4 KB fill one flash sector
+ */
+#define SPOOL_SEGMENT_RECORDS   256
+
+/**
+ * Number of segment files, the oldest one is dropped when all are full
+ */
+#define SPOOL_MAX_SEGMENTS      16
+
+/**
+ * Size of a segment path buffer, "/spool/NN.bin" and terminator
+ */
+#define SPOOL_PATH_SIZE         16
+
+/**
+ * CRC of a record, same parameters as the SHT3x CRC so both share one table
+ */
+#define SPOOL_CRC_POLYNOMIAL    0x31
+#define SPOOL_CRC_INIT          0xFF
+
+/**
+ * Sample read back from the spool
+ */
+struct SpoolRecord
+{
+    /**
+     * Sequence number, continues over reboots while the spool is not empty
+    */
+    uint32_t iSeq;
+
+    /**
+     * Time the sample was taken at, millis() of the boot the record was written in
+    */
+    uint32_t iTimestamp;
+
+    /**
+     * Random number identifying the boot, timestamps of other boots have no
+     * relation to millis()
+    */
+    uint16_t iBootId;
+
+    int16_t iTempCenti;
+    uint16_t iHumCenti;
+
+    /**
+     * Same bits as in the binary telemetry frame
+    */
+    uint8_t iFlags;
+};
+
+struct SpoolStats
+{
+    uint32_t iSpooled;
+    uint32_t iReplayed;
+
+    /**
+     * Records lost to the size bound or to a failed write
+    */
+    uint32_t iDropped;
+
+    /**
+     * Records skipped on replay because of a CRC mismatch
+    */
+    uint32_t iCorrupt;
+
+    uint32_t iWriteErrors;
+};
+
+/**
+ * Store-and-forward queue of samples taken while the broker is unreachable
+ *
+ * Records are appended to a ring of segment files and never rewritten: the
+ * replay position lives in RAM and a segment is removed as a whole once
+ * replayed, so every flash page is written once per pass of the ring. After a
+ * reboot the spool is rebuilt from the files, a segment replayed only in part
+ * is then sent again and the backend drops the duplicates by sequence number.
+ *
+ * Record layout, multi-byte fields are little endian:
+ *
+ *  offset  size  field
+ *  0       4     sequence number, uint32
+ *  4       4     timestamp, uint32, ms
+ *  8       2     boot id, uint16
+ *  10      2     temperature, int16, 0.01 degC
+ *  12      2     humidity, uint16, 0.01 %RH
+ *  14      1     flags
+ *  15      1     CRC-8 of bytes 0 to 14
+ */
+class TelemetrySpool
+{
+    fs::FS &iFs;
+
+    uint16_t iBootId;
+    uint32_t iNextSeq;
+
+    /**
+     * Ring of segment slots, iHeadSlot holds the oldest segment
+    */
+    uint8_t iHeadSlot;
+    uint8_t iSegments;
+
+    /**
+     * Records in the oldest segment and how many of them were replayed
+    */
+    uint16_t iHeadRecords;
+    uint16_t iReadRecords;
+
+    /**
+     * Records in the newest segment, appending to it stops after a failed write
+    */
+    uint16_t iTailRecords;
+    bool iTailSealed;
+
+    uint32_t iPending;
+
+    /**
+     * Raw and corrupt records read by the last Peek(), waiting for Commit()
+    */
+    uint8_t iPeekRaw;
+    uint8_t iPeekCorrupt;
+
+    SpoolStats iStats;
+
+    static void MakePath( const uint8_t aSlot, char *aPath );
+
+    static void Encode( const SpoolRecord &aRecord, uint8_t *aBuff );
+
+    /**
+     * Decodes a stored record
+     *
+     * @return False on a CRC mismatch
+    */
+    static bool Decode( const uint8_t *aBuff, SpoolRecord &aRecord );
+
+    /**
+     * Reads the first or the last valid record of a segment
+     *
+     * @return False if the segment holds no valid record
+    */
+    bool ReadEdge( fs::File &aFile, const uint16_t aRecords, const bool aLast, SpoolRecord &aRecord );
+
+    /**
+     * Removes the oldest segment, records not replayed yet are dropped
+    */
+    void RemoveHead();
+
+    public:
+        TelemetrySpool( fs::FS &aFs ):
+            iFs( aFs ),
+            iBootId( 0 ),
+            iNextSeq( 0 ),
+            iHeadSlot( 0 ),
+            iSegments( 0 ),
+            iHeadRecords( 0 ),
+            iReadRecords( 0 ),
+            iTailRecords( 0 ),
+            iTailSealed( false ),
+            iPending( 0 ),
+            iPeekRaw( 0 ),
+            iPeekCorrupt( 0 ),
+            iStats()
+        {
+        }
+
+        /**
+         * Rebuilds the spool from segment files left by previous boots, call
+         * once the file system is mounted
+         *
+         * @param aBootId identifier of the current boot, e.g. a random number
+         * @return Number of records waiting for replay
+        */
+        uint32_t Begin( const uint16_t aBootId );
+
+        /**
+         * Appends a sample, drops the oldest segment if the spool is full
+         *
+         * @return False if the sample could not be written
+        */
+        bool Push( const TelemetrySample &aSample );
+
+        /**
+         * Reads the oldest records without removing them, corrupt ones are skipped
+         *
+         * @param aRecords output records
+         * @param aMax capacity of aRecords
+         * @return Number of valid records, zero may still need a Commit() to
+         *         skip corrupt ones if GetPending() is not zero
+        */
+        uint8_t Peek( SpoolRecord aRecords[], const uint8_t aMax );
+
+        /**
+         * Removes records read by the last Peek(), call once they are delivered
+        */
+        void Commit();
+
+        uint32_t GetPending() const
+        {
+            return iPending;
+        }
+
+        const SpoolStats& GetStats() const
+        {
+            return iStats;
+        }
+};
+
+#endif /* __TELEMETRY_SPOOL_H__ */
@@ -0,0 +1,130 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <Arduino.h>
+#include <EEPROM.h>
+#include "WifiFastConnect.h"
+
+uint8_t WifiFastConnect::Checksum( const Cache &aCache )
+{
+    const uint8_t *bytes = reinterpret_cast<const uint8_t*>( &aCache );
+    uint8_t sum = 0;
+
+    for ( uint32_t byte = 0; byte < sizeof aCache; ++byte )
+    {
+        // Checksum byte itself is skipped
+        if ( &bytes[byte] != &aCache.iChecksum )
+        {
+            sum = ( sum << 1 | sum >> 7 ) ^ bytes[byte];
+        }
+    }
+
+    return sum;
+}
+
+bool WifiFastConnect::WaitConnected( const uint32_t aTimeout )
+{
+    const uint64_t start = millis();
+
+    while ( WiFi.status() != WL_CONNECTED )
+    {
+        if ( millis() - start >= aTimeout )
+        {
+            return false;
+        }
+
+        delay( WIFI_POLL_INTERVAL_MS );
+    }
+
+    return true;
+}
+
+void WifiFastConnect::LoadCache()
+{
+    EEPROM.get( WIFI_CACHE_EEPROM_ADDR, iCache );
+
+    if ( ( iCache.iMagic != WIFI_CACHE_MAGIC ) || ( iCache.iChecksum != Checksum( iCache ) ) )
+    {
+        memset( &iCache, 0, sizeof iCache );
+    }
+}
+
+void WifiFastConnect::StoreCache()
+{
+    Cache cache = {};
+
+    cache.iMagic = WIFI_CACHE_MAGIC;
+    memcpy( cache.iBssid, WiFi.BSSID(), sizeof cache.iBssid );
+    cache.iChannel = WiFi.channel();
+    cache.iChecksum = Checksum( cache );
+
+    // Flash is only written when the association changed
+    if ( memcmp( &cache, &iCache, sizeof cache ) != 0 )
+    {
+        iCache = cache;
+        EEPROM.put( WIFI_CACHE_EEPROM_ADDR, iCache );
+        EEPROM.commit();
+    }
+}
+
+void WifiFastConnect::Invalidate()
+{
+    memset( &iCache, 0, sizeof iCache );
+    EEPROM.put( WIFI_CACHE_EEPROM_ADDR, iCache );
+    EEPROM.commit();
+}
+
+bool WifiFastConnect::Connect( const char *aSsid, const char *aPassword )
+{
+    const uint64_t start = millis();
+    bool connected = false;
+
+    // SDK must not store its own copy of the configuration on every connect
+    WiFi.persistent( false );
+    WiFi.mode( WIFI_STA );
+
+    LoadCache();
+
+    iFastPathUsed = false;
+
+    if ( iStaticIp != 0 )
+    {
+        WiFi.config( iStaticIp, iStaticGateway, iStaticSubnet, iStaticDns );
+    }
+    else
+    {
+        // Zero addresses keep the interface on DHCP
+        WiFi.config( IPAddress( (uint32_t) 0 ), IPAddress( (uint32_t) 0 ), IPAddress( (uint32_t) 0 ) );
+    }
+
+    if ( iCache.iMagic == WIFI_CACHE_MAGIC )
+    {
+        // Direct association skips the scan of all channels
+        WiFi.begin( aSsid, aPassword, iCache.iChannel, iCache.iBssid );
+
+        connected = WaitConnected( WIFI_FAST_TIMEOUT_MS );
+        iFastPathUsed = connected;
+
+        if ( !connected )
+        {
+            Serial.println( "Cached WiFi association failed, scanning" );
+            WiFi.disconnect();
+        }
+    }
+
+    if ( !connected )
+    {
+        WiFi.begin( aSsid, aPassword );
+
+        connected = WaitConnected( WIFI_SCAN_TIMEOUT_MS );
+    }
+
+    iConnectTimeMs = millis() - start;
+
+    if ( connected )
+    {
+        StoreCache();
+    }
+
+    return connected;
+}
@@ -0,0 +1,137 @@
+#ifndef __WIFI_FAST_CONNECT_H__
+#define __WIFI_FAST_CONNECT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <WiFi.h>
+
+/**
+ * EEPROM address of the cached association, placed behind stored credentials
+ */
+#define WIFI_CACHE_EEPROM_ADDR      256
+
+/**
+ * Marker of a valid cache record, low byte is the record layout version
+ */
+#define WIFI_CACHE_MAGIC            0x57464302
+
+/**
+ * Interval of association status polling in milliseconds
+ */
+#define WIFI_POLL_INTERVAL_MS       10
+
+/**
+ * Time given to direct association with the cached access point and its DHCP
+ * exchange in milliseconds
+ */
+#define WIFI_FAST_TIMEOUT_MS        3000
+
+/**
+ * Time given to association after a full scan in milliseconds
+ */
+#define WIFI_SCAN_TIMEOUT_MS        10000
+
+class WifiFastConnect
+{
+    /**
+     * Association parameters kept in EEPROM between boots
+    */
+    struct Cache
+    {
+        uint32_t iMagic;
+        uint8_t iBssid[6];
+        uint8_t iChannel;
+        uint8_t iChecksum;
+    };
+
+    Cache iCache;
+
+    /**
+     * Configured static IP, zero when DHCP is used
+    */
+    uint32_t iStaticIp;
+    uint32_t iStaticGateway;
+    uint32_t iStaticSubnet;
+    uint32_t iStaticDns;
+
+    /**
+     * Duration of the last connect and whether the cached association was used
+    */
+    uint32_t iConnectTimeMs;
+    bool iFastPathUsed;
+
+    static uint8_t Checksum( const Cache &aCache );
+
+    /**
+     * Polls association status until connected or timeout elapses
+     *
+     * @param aTimeout timeout in milliseconds
+     * @return True if connected
+    */
+    static bool WaitConnected( const uint32_t aTimeout );
+
+    void LoadCache();
+
+    /**
+     * Stores current association to EEPROM if it differs from the cached one
+    */
+    void StoreCache();
+
+    public:
+        WifiFastConnect():
+            iCache{},
+            iStaticIp( 0 ),
+            iStaticGateway( 0 ),
+            iStaticSubnet( 0 ),
+            iStaticDns( 0 ),
+            iConnectTimeMs( 0 ),
+            iFastPathUsed( false )
+        {
+        }
+
+        /**
+         * Configures static IP used instead of DHCP
+         *
+         * @param aIp local address
+         * @param aGateway gateway address
+         * @param aSubnet subnet mask
+         * @param aDns DNS server address
+        */
+        void SetStaticIp( const IPAddress &aIp, const IPAddress &aGateway,
+                          const IPAddress &aSubnet, const IPAddress &aDns )
+        {
+            iStaticIp = aIp;
+            iStaticGateway = aGateway;
+            iStaticSubnet = aSubnet;
+            iStaticDns = aDns;
+        }
+
+        /**
+         * Connects to a network, directly to the cached access point first and
+         * with a full scan if that fails. EEPROM must be initialized before.
+         * Without a static IP the address always comes from DHCP, a cached
+         * lease would not be renewed and could collide once it expired.
+         *
+         * @param aSsid network name
+         * @param aPassword network password
+         * @return True if connected
+        */
+        bool Connect( const char *aSsid, const char *aPassword );
+
+        /**
+         * Forgets the cached association, e.g. after the network was changed
+        */
+        void Invalidate();
+
+        uint32_t GetConnectTimeMs() const
+        {
+            return iConnectTimeMs;
+        }
+
+        bool IsFastPathUsed() const
+        {
+            return iFastPathUsed;
+        }
+};
+
+#endif /* __WIFI_FAST_CONNECT_H__ */
@@ -47,11 +47,28 @@ String read_String(char add)
 #include "Interrupt.h"
 #include "MotionSensor.h"
 #include "ShtSensor.h"
+#include "I2cBusManager.h"
 #include <WiFi.h>
 #include <EEPROM.h>
 #include <PubSubClient.h>
 #include <Arduino.h>
 #include "ESP32httpUpdate.h"
+#include "MqttConnection.h"
+#include "WifiFastConnect.h"
+#include "TelemetryCodec.h"
+#include "SampleBatch.h"
+#include "ChangeDetector.h"
+#include "ReadingFilter.h"
+#include "AcquisitionScheduler.h"
+#include "PinnedTask.h"
+#include "CoopScheduler.h"
+#include "DeepSleepCycle.h"
+#include "RtcSampleLog.h"
+#include "TelemetrySpool.h"
+#include <SPIFFS.h>
+#include <esp_system.h>
+#include <time.h>
+#include "SpscQueue.h"
 #include <ArduinoJson.h>
 
 String ssid;
@@ -60,51 +77,487 @@ String mqtt_server;
 String mqtt_name;
 String mqtt_password;
 
+WifiFastConnect wifi;
 WiFiClient espClient;
 PubSubClient client(espClient);
+void onMqttConnected(PubSubClient &aClient);
+MqttConnection mqtt(client, onMqttConnected);
 unsigned long lastMsg = 0;
 #define MSG_BUFFER_SIZE (256)
+
+// Build with -D TELEMETRY_BINARY to publish compact frames on nova_skusobna_out_bin instead of JSON
+#define FIRMWARE_VERSION        "0.4"
+#define FIRMWARE_VERSION_MAJOR  0
+#define FIRMWARE_VERSION_MINOR  4
+
+// Defaults of batch publishing, overridable per device over nova_skusobna_config
+#ifndef BATCH_MAX_COUNT
+#define BATCH_MAX_COUNT         1
+#endif
+#ifndef BATCH_MAX_AGE_MS
+#define BATCH_MAX_AGE_MS        60000
+#endif
+#ifndef BATCH_MAX_BYTES
+#define BATCH_MAX_BYTES         512
+#endif
+#define BATCH_BUFFER_SIZE       (1024)
+
+// Keys of nova_skusobna_config and room for copies of their names
+#define CONFIG_JSON_KEYS        15
+#define CONFIG_JSON_SIZE        (JSON_OBJECT_SIZE(CONFIG_JSON_KEYS) + CONFIG_JSON_KEYS * 16)
+
+// Worst-case size of the JSON batch header and of one [dt,temp,hum,mov,rssi] entry,
+// taken from the longest values of their fields, the header counts the terminating zero
+#define BATCH_JSON_HEADER_BYTES (sizeof "{\"version\":\"" FIRMWARE_VERSION "\",\"t0\":4294967295,\"dropped\":4294967295,\"s\":[]}")
+#define BATCH_JSON_SAMPLE_BYTES (sizeof "[4294967295,-32768,65535,1,-128]," - 1)
+
+// Encoded sizes of the batch format in use
+#ifdef TELEMETRY_BINARY
+#define BATCH_HEADER_BYTES      TELEMETRY_BATCH_HEADER_SIZE
+#define BATCH_SAMPLE_BYTES      TELEMETRY_BATCH_SAMPLE_SIZE
+#else
+#define BATCH_HEADER_BYTES      BATCH_JSON_HEADER_BYTES
+#define BATCH_SAMPLE_BYTES      BATCH_JSON_SAMPLE_BYTES
+#endif
+
+// Number of samples whose batch fits batchMsg
+#define BATCH_BUFFER_SAMPLES    ((BATCH_BUFFER_SIZE - BATCH_HEADER_BYTES) / BATCH_SAMPLE_BYTES)
+
+// Filter windows go out with single-sample JSON only, batches and binary frames have no room for them
+#ifdef TELEMETRY_BINARY
+#define REPORT_WINDOWS          false
+#else
+#define REPORT_WINDOWS          (BATCH_MAX_COUNT <= 1)
+#endif
+
+// Defaults of report-on-change, overridable per device over nova_skusobna_config
+#ifndef REPORT_ON_CHANGE
+#define REPORT_ON_CHANGE        false
+#endif
+#define CHANGE_TEMP_DEADBAND    10      // 0.1 degC
+#define CHANGE_HUM_DEADBAND     100     // 1 %RH
+#define CHANGE_REL_DEADBAND     0       // per mille
+#define CHANGE_HEARTBEAT_MS     60000
+#define CHANGE_MIN_INTERVAL_MS  500
+#define CHANGE_CHECK_PERIOD_MS  100
+
+// Bounds of the sampling period set over nova_skusobna_config, the report
+// job takes it in microseconds which must fit 32 bits
+#define SAMPLE_PERIOD_MIN_MS    100
+#define SAMPLE_PERIOD_MAX_MS    3600000
+
+// SHT sensor measures single shots at an adaptive interval, build with
+// e.g. -D SHT_PERIODIC_RATE=PeriodicCmd::eOneMps for fixed periodic acquisition
+#ifndef ACQ_BASE_MS
+#define ACQ_BASE_MS             1000
+#endif
+#ifndef ACQ_MIN_MS
+#define ACQ_MIN_MS              250
+#endif
+#ifndef ACQ_MAX_MS
+#define ACQ_MAX_MS              10000
+#endif
+#define ACQ_TEMP_FAST           50      // 0.5 degC per minute
+#define ACQ_HUM_FAST            100     // 1 %RH per minute
+
+// Acquisition task reads sensors on core 1, network task runs Wi-Fi and MQTT on core 0
+#ifndef ACQ_TASK_PRIORITY
+#define ACQ_TASK_PRIORITY       3
+#endif
+#ifndef ACQ_TASK_STACK
+#define ACQ_TASK_STACK          4096
+#endif
+#define ACQ_TASK_CORE           1
+#ifndef NET_TASK_PRIORITY
+#define NET_TASK_PRIORITY       1
+#endif
+#ifndef NET_TASK_STACK
+#define NET_TASK_STACK          8192
+#endif
+#define NET_TASK_CORE           0
+// OTA downloads run in their own task, so MQTT keepalive and telemetry go on meanwhile
+#ifndef OTA_TASK_PRIORITY
+#define OTA_TASK_PRIORITY       1
+#endif
+#ifndef OTA_TASK_STACK
+#define OTA_TASK_STACK          8192
+#endif
+#define OTA_TASK_CORE           0
+#define OTA_POLL_US             100000
+#define OTA_STATUS_FLUSH_MS     2000
+
+// Periods of jobs of both tasks, tasks sleep until the earliest deadline
+#define MOTION_JOB_PERIOD_US    10000
+#define LED_JOB_PERIOD_US       50000
+#define SETTINGS_JOB_PERIOD_US  100000
+#define MQTT_JOB_PERIOD_US      10000
+#define PUBLISH_JOB_PERIOD_US   10000
+#define METRICS_JOB_PERIOD_US   60000000
+#define REPLAY_JOB_PERIOD_US    1000000
+#define TASK_MAX_SLEEP_US       1000000
+
+// Battery mode, e.g. -D BATTERY_MODE in wemosbat_development: one measurement per wake-up, then deep sleep
+#ifndef BATTERY_SLEEP_S
+#define BATTERY_SLEEP_S         300
+#endif
+#define BATTERY_SENSOR_TIMEOUT_MS   100
+// Radio comes up every Nth wake-up or once a reading moves past a threshold
+#ifndef BATTERY_FLUSH_WAKES
+#define BATTERY_FLUSH_WAKES         12
+#endif
+#define BATTERY_FLUSH_TEMP          50      // 0.5 degC
+#define BATTERY_FLUSH_HUM           300     // 3 %RH
+#define BATTERY_MQTT_TIMEOUT_MS     5000
+#define BATTERY_PUBLISH_DRAIN_MS    100
+
+// Samples taken while the broker is unreachable are spooled to SPIFFS and
+// replayed at most SPOOL_REPLAY_BURST per REPLAY_JOB_PERIOD_US after reconnect
+#define SPOOL_REPLAY_BURST      16
+
+// Capacity of the queues between the tasks
+#define REPORT_QUEUE_SIZE       8
+#define MOTION_QUEUE_SIZE       8
+#define SETTINGS_QUEUE_SIZE     2
+#define OTA_QUEUE_SIZE          2
+#define OTA_STATUS_QUEUE_SIZE   8
+
+// Filter stage of every sensor result, overridable per device over nova_skusobna_config
+#ifndef FILTER_MEDIAN_LENGTH
+#define FILTER_MEDIAN_LENGTH    5
+#endif
+#ifndef FILTER_EMA_SHIFT
+#define FILTER_EMA_SHIFT        2
+#endif
+#define FILTER_TEMP_OUTLIER     200     // 2 degC
+#define FILTER_HUM_OUTLIER      500     // 5 %RH
+#define FILTER_MAX_OUTLIERS     3
+
 char msg[MSG_BUFFER_SIZE];
+char batchMsg[BATCH_BUFFER_SIZE];
 int value = 0;
 
+/**
+ * Sample with its window statistics, passed from the acquisition task to the network task
+ */
+struct TelemetryReport
+{
+  TelemetrySample iSample;
+  WindowRecord iTempWindow;
+  WindowRecord iHumWindow;
+  uint32_t iIntervalMs;
+};
+
+/**
+ * Configuration of the acquisition task, changed by the network task
+ */
+struct AcquisitionSettings
+{
+  ChangeConfig iChange;
+  FilterConfig iTempFilter;
+  FilterConfig iHumFilter;
+  AcquisitionConfig iAcquisition;
+  uint32_t iSamplePeriodMs;
+  bool iWindows;
+};
+
+/**
+ * Firmware download requested over nova_skusobna_update, passed to the OTA task
+ */
+struct UpdateRequest
+{
+  char iHost[64];
+  char iPath[128];
+};
+
+/**
+ * Enum representing states published on nova_skusobna_update_status
+ */
+enum UpdateState : uint8_t
+{
+  eUpdateQueued,
+  eUpdateBusy,
+  eUpdateDownloading,
+  eUpdateNoUpdate,
+  eUpdateOk,
+  eUpdateFailed
+};
+
+/**
+ * Progress or result of an update, passed from the OTA task to the network task
+ */
+struct UpdateStatus
+{
+  UpdateState iState;
+  int16_t iError;
+  uint32_t iReceived;
+  uint32_t iTotal;
+  uint32_t iBytesPerSecond;
+  uint32_t iResumes;
+  char iMessage[40];
+};
+
+// Copy owned by the network task, the acquisition task gets it over settingsQueue
+AcquisitionSettings settings = {
+  {REPORT_ON_CHANGE,
+   {CHANGE_TEMP_DEADBAND, CHANGE_REL_DEADBAND},
+   {CHANGE_HUM_DEADBAND, CHANGE_REL_DEADBAND},
+   CHANGE_HEARTBEAT_MS, CHANGE_MIN_INTERVAL_MS},
+  {FILTER_MEDIAN_LENGTH, FILTER_EMA_SHIFT, FILTER_TEMP_OUTLIER, FILTER_MAX_OUTLIERS},
+  {FILTER_MEDIAN_LENGTH, FILTER_EMA_SHIFT, FILTER_HUM_OUTLIER, FILTER_MAX_OUTLIERS},
+  {ACQ_BASE_MS, ACQ_MIN_MS, ACQ_MAX_MS, ACQ_TEMP_FAST, ACQ_HUM_FAST},
+  2000,
+  REPORT_WINDOWS
+};
+
+SpscQueue<TelemetryReport, REPORT_QUEUE_SIZE> reportQueue;
+SpscQueue<InterruptEvent, MOTION_QUEUE_SIZE> motionQueue;
+SpscQueue<AcquisitionSettings, SETTINGS_QUEUE_SIZE> settingsQueue;
+SpscQueue<UpdateRequest, OTA_QUEUE_SIZE> updateQueue;
+SpscQueue<UpdateStatus, OTA_STATUS_QUEUE_SIZE> updateStatusQueue;
+
+uint32_t samplePeriodMs = settings.iSamplePeriodMs;
+bool reportWindows = settings.iWindows;
+
+SampleBatch batch({BATCH_MAX_COUNT, BATCH_MAX_AGE_MS, BATCH_MAX_BYTES}, BATCH_HEADER_BYTES, BATCH_SAMPLE_BYTES);
+
+ChangeDetector changeDetector(settings.iChange);
+
+ReadingFilter tempFilter(settings.iTempFilter);
+ReadingFilter humFilter(settings.iHumFilter);
+
+AcquisitionScheduler acquisition(settings.iAcquisition);
+
+uint32_t acquisitionStep();
+uint32_t networkStep();
+uint32_t updateStep();
+void runSensor();
+void runMotion();
+void runLed();
+void runSettings();
+void runReport();
+void runMqtt();
+void runPublish();
+void publishTaskMetrics();
+void runReplay();
+
+PinnedTask acquisitionTask({"acquisition", ACQ_TASK_CORE, ACQ_TASK_PRIORITY, ACQ_TASK_STACK}, acquisitionStep);
+PinnedTask networkTask({"network", NET_TASK_CORE, NET_TASK_PRIORITY, NET_TASK_STACK}, networkStep);
+PinnedTask updateTask({"ota", OTA_TASK_CORE, OTA_TASK_PRIORITY, OTA_TASK_STACK}, updateStep);
+
+// Jobs of each task, a scheduler is only ever run and changed by its own task
+CoopScheduler acquisitionJobs;
+CoopScheduler networkJobs;
+uint8_t sensorJob;
+uint8_t reportJob;
+
+// Tells replayed timestamps of this boot from those of previous ones
+uint16_t bootId;
+
+
+DeepSleepCycle sleepCycle(BATTERY_SLEEP_S, MOTION_SENSOR_PIN);
+
+// Readings of the wake-ups between two flushes, kept in RTC slow memory over deep sleep
+RTC_DATA_ATTR RtcSampleLog sampleLog;
 
-ShtSensor TempHumSesnor = ShtSensor( 21, 22 );
+// Samples of broker outages, owned by the network task
+TelemetrySpool spool(SPIFFS);
+
+I2cBusManager i2cBuses;
+ShtSensor TempHumSesnor = ShtSensor( i2cBuses.GetWire( 0 ) );
 MotionSensor MotSensor = MotionSensor( 15 );
 
 void setup_wifi()
 {
-  delay(10);
   // We start by connecting to a WiFi network
   Serial.println();
   Serial.print("Connecting to ");
   Serial.println(ssid);
 
-  ssid = "Jakubcata & BW";//read_String(0);
-  password = "NaJednejCeste";//read_String(30);
-  WiFi.begin(ssid.c_str(), password.c_str());
+#ifdef WIFI_STATIC_IP
+  // e.g. -D WIFI_STATIC_IP=192,168,1,50 -D WIFI_GATEWAY=192,168,1,1
+  wifi.SetStaticIp(IPAddress(WIFI_STATIC_IP), IPAddress(WIFI_GATEWAY), IPAddress(255, 255, 255, 0), IPAddress(WIFI_GATEWAY));
+#endif
 
-  static uint64_t timestamp = millis();
-
-  while (WiFi.status() != WL_CONNECTED)
+  if (!wifi.Connect(ssid.c_str(), password.c_str()))
   {
-    delay(500);
-
-    Serial.print(".");
-    if (millis() - timestamp >= 10000)
-    {
-        ESP.restart();
-    }   
+    ESP.restart();
   }
 
+  Serial.printf("WiFi connected in %u ms (%s)\n", wifi.GetConnectTimeMs(), wifi.IsFastPathUsed() ? "cached" : "scan");
+
   randomSeed(micros());
 
-  Serial.println("");
-  Serial.println("WiFi connected");
   Serial.println("IP address: ");
   Serial.println(WiFi.localIP());
 }
 
 
+void applyConfig(byte *payload, unsigned int length)
+{
+  // e.g. {"batch_count":10,"batch_age_ms":60000,"batch_bytes":512,"sample_ms":2000,
+  //       "roc":true,"temp_db":10,"hum_db":100,"heartbeat_ms":60000,"median":5,"ema_shift":2,
+  //       "acq_ms":1000,"acq_min_ms":250,"acq_max_ms":10000}
+  StaticJsonDocument<CONFIG_JSON_SIZE> json;
+  const DeserializationError error = deserializeJson(json, payload, length);
+  if (error)
+  {
+    Serial.printf("Invalid config message: %s\n", error.c_str());
+    return;
+  }
+
+  // Limits are checked before they are narrowed to the fields of BatchConfig
+  BatchConfig config = batch.GetConfig();
+  const uint32_t batchCount = json["batch_count"] | (uint32_t)config.iMaxCount;
+  const uint32_t batchBytes = json["batch_bytes"] | (uint32_t)config.iMaxBytes;
+  config.iMaxCount = (batchCount > SAMPLE_BATCH_CAPACITY) ? SAMPLE_BATCH_CAPACITY : batchCount;
+  const uint32_t batchAge = json["batch_age_ms"] | config.iMaxAgeMs;
+#ifdef TELEMETRY_BINARY
+  // Samples of a binary batch are at most UINT16_MAX ms apart
+  config.iMaxAgeMs = (batchAge > UINT16_MAX) ? UINT16_MAX : batchAge;
+#else
+  config.iMaxAgeMs = batchAge;
+#endif
+  // The byte budget includes the header, a whole batch must fit batchMsg
+  config.iMaxBytes = (batchBytes > BATCH_BUFFER_SIZE) ? BATCH_BUFFER_SIZE :
+                     (batchBytes < BATCH_HEADER_BYTES + BATCH_SAMPLE_BYTES) ? BATCH_HEADER_BYTES + BATCH_SAMPLE_BYTES : batchBytes;
+  batch.SetConfig(config);
+#ifndef TELEMETRY_BINARY
+  settings.iWindows = batch.IsDisabled();
+#endif
+
+  // Settings of the acquisition task are applied there, between two of its steps
+  const uint32_t samplePeriod = json["sample_ms"] | settings.iSamplePeriodMs;
+  settings.iSamplePeriodMs = (samplePeriod < SAMPLE_PERIOD_MIN_MS) ? SAMPLE_PERIOD_MIN_MS :
+                             (samplePeriod > SAMPLE_PERIOD_MAX_MS) ? SAMPLE_PERIOD_MAX_MS : samplePeriod;
+
+  ChangeConfig &change = settings.iChange;
+  change.iEnabled = json["roc"] | change.iEnabled;
+  change.iTemp.iAbsCenti = json["temp_db"] | change.iTemp.iAbsCenti;
+  change.iTemp.iRelPermille = json["temp_rel_db"] | change.iTemp.iRelPermille;
+  change.iHum.iAbsCenti = json["hum_db"] | change.iHum.iAbsCenti;
+  change.iHum.iRelPermille = json["hum_rel_db"] | change.iHum.iRelPermille;
+  change.iHeartbeatMs = json["heartbeat_ms"] | change.iHeartbeatMs;
+
+  FilterConfig &tempConfig = settings.iTempFilter;
+  FilterConfig &humConfig = settings.iHumFilter;
+  tempConfig.iMedianLength = humConfig.iMedianLength = json["median"] | tempConfig.iMedianLength;
+  tempConfig.iEmaShift = humConfig.iEmaShift = json["ema_shift"] | tempConfig.iEmaShift;
+
+  AcquisitionConfig &acq = settings.iAcquisition;
+  acq.iBaseMs = json["acq_ms"] | acq.iBaseMs;
+  acq.iMinMs = json["acq_min_ms"] | acq.iMinMs;
+  acq.iMaxMs = json["acq_max_ms"] | acq.iMaxMs;
+
+  if (!settingsQueue.Push(settings))
+  {
+    Serial.println("Config dropped, acquisition task is busy");
+  }
+
+  Serial.printf("Config: batch %u samples / %u ms / %u bytes, sample every %u ms\n",
+    batch.GetConfig().iMaxCount, batch.GetConfig().iMaxAgeMs, batch.GetConfig().iMaxBytes, settings.iSamplePeriodMs);
+}
+
+void applySettings(const AcquisitionSettings &update)
+{
+  samplePeriodMs = update.iSamplePeriodMs;
+
+  // Windows were not taken while batching, the first one published would span all that time
+  if (update.iWindows && !reportWindows)
+  {
+    tempFilter.TakeWindow();
+    humFilter.TakeWindow();
+  }
+  reportWindows = update.iWindows;
+
+  changeDetector.SetConfig(update.iChange);
+  tempFilter.SetConfig(update.iTempFilter);
+  humFilter.SetConfig(update.iHumFilter);
+  acquisition.SetConfig(update.iAcquisition);
+
+  // New report period starts right away instead of after the old one
+  const uint32_t reportPeriodMs = changeDetector.IsEnabled() ? CHANGE_CHECK_PERIOD_MS : samplePeriodMs;
+  acquisitionJobs.SetPeriod(reportJob, reportPeriodMs * 1000);
+  acquisitionJobs.Trigger(reportJob, reportPeriodMs * 1000);
+}
+
+void publishUpdateStatus(const UpdateStatus &status)
+{
+  static const char *states[] = {"queued", "busy", "downloading", "no_update", "ok", "failed"};
+  char payload[192];
+
+  snprintf(payload, sizeof payload,
+    "{\"state\":\"%s\",\"recv\":%u,\"total\":%u,\"bps\":%u,\"resumes\":%u,\"error\":%d,\"msg\":\"%s\"}",
+    states[status.iState], status.iReceived, status.iTotal, status.iBytesPerSecond, status.iResumes,
+    status.iError, status.iMessage);
+
+  if (mqtt.IsConnected())
+  {
+    client.publish("nova_skusobna_update_status", payload);
+  }
+}
+
+UpdateStatus makeUpdateStatus(const UpdateState state, const HTTPUpdateStats &stats)
+{
+  UpdateStatus status = {};
+
+  status.iState = state;
+  status.iReceived = stats.received;
+  status.iTotal = stats.total;
+  status.iBytesPerSecond = stats.bytesPerSecond;
+  status.iResumes = stats.resumes;
+
+  return status;
+}
+
+void reportUpdateProgress(const HTTPUpdateStats &stats)
+{
+  static uint32_t lastDecile = 0;
+  const uint32_t decile = stats.total ? (uint64_t)stats.received * 10 / stats.total : 0;
+
+  // Runs in the OTA task, the network task publishes every 10 %
+  if ((decile != lastDecile) || (stats.received == stats.total))
+  {
+    Serial.printf("OTA %u/%u bytes, %u B/s, %u resumes, %u ms waiting for flash\n",
+      stats.received, stats.total, stats.bytesPerSecond, stats.resumes, stats.flashWaitMs);
+    updateStatusQueue.Push(makeUpdateStatus(eUpdateDownloading, stats));
+    lastDecile = decile;
+  }
+}
+
+void queueUpdate(const byte *payload, const unsigned int length)
+{
+  UpdateRequest request;
+  UpdateStatus status = {};
+  DynamicJsonDocument json(150);
+
+  status.iState = eUpdateQueued;
+
+  const DeserializationError error = deserializeJson(json, payload, length);
+  const char *host = json["host"];
+  const char *path = json["path"];
+
+  if (error || (host == nullptr) || (path == nullptr) ||
+      (strlen(host) >= sizeof request.iHost) || (strlen(path) >= sizeof request.iPath))
+  {
+    status.iState = eUpdateFailed;
+    snprintf(status.iMessage, sizeof status.iMessage, "Bad request");
+  }
+  else
+  {
+    snprintf(request.iHost, sizeof request.iHost, "%s", host);
+    snprintf(request.iPath, sizeof request.iPath, "%s", path);
+    Serial.printf("%s %s\n", host, path);
+
+    // One download runs and one waits, more requests are refused
+    if (!updateQueue.Push(request))
+    {
+      status.iState = eUpdateBusy;
+    }
+  }
+
+  publishUpdateStatus(status);
+}
+
 void callback(char *topic, byte *payload, unsigned int length){
   Serial.print("Message arrived [");
   Serial.print(topic);
@@ -116,29 +569,13 @@ void callback(char *topic, byte *payload, unsigned int length){
 
   if(strcmp(topic,"nova_skusobna_update") == 0)
   {
-    DynamicJsonDocument json(150);
-    deserializeJson(json, (char*)payload);
-    JsonObject update_meta = json.as<JsonObject>();
-    const char* host = update_meta["host"];
-    const char* path = update_meta["path"];
-
-    Serial.printf("%s %s\n", host, path);
-    t_httpUpdate_return ret = ESPhttpUpdate.update(host, 80, path);
-
-    switch (ret)
-    {
-    case HTTP_UPDATE_FAILED:
-      Serial.printf("HTTP_UPDATE_FAILD Error (%d): %s", ESPhttpUpdate.getLastError(), ESPhttpUpdate.getLastErrorString().c_str());
-      break;
-    case HTTP_UPDATE_NO_UPDATES:
-      Serial.println("HTTP_UPDATE_NO_UPDATES");
-      break;
-    case HTTP_UPDATE_OK:
-      Serial.println("HTTP_UPDATE_OK");
-      ESP.restart();
-      break;
-    }
+    // Downloads take minutes, the OTA task runs them while client.loop() keeps going
+    queueUpdate(payload, length);
   } 
+  else if(strcmp(topic,"nova_skusobna_config") == 0)
+  {
+    applyConfig(payload, length);
+  }
   else
   {
     Serial.print("no update\n");
@@ -155,35 +592,423 @@ void callback(char *topic, byte *payload, unsigned int length){
   }
 }
 
-void reconnect()
+void onMqttConnected(PubSubClient &aClient)
 {
-  // Loop until we're reconnected
-  while (!client.connected())
+  // Once connected, publish an announcement...
+  aClient.publish("outTopic", "hello world");
+  // ... and resubscribe
+  aClient.subscribe("nova_skusobna_in");
+  aClient.subscribe("nova_skusobna_update");
+  aClient.subscribe("nova_skusobna_config");
+}
+
+void filterResults()
+{
+  static uint32_t lastResults;
+  const uint32_t results = TempHumSesnor.GetStats().iResults;
+
+  // Every new result passes the filters once, so windows count real measurements
+  if (results != lastResults)
   {
-    Serial.print("Attempting MQTT connection...");
-    // Create a random client ID
-    String clientId = "ESP8266Client-";
-    clientId += String(random(0xffff), HEX);
-    // Attempt to connect
-    if (  client.connect("nova_skusobna", mqtt_name.c_str(), mqtt_password.c_str()) )
-    {
-      Serial.println("connected");
-      // Once connected, publish an announcement...
-      client.publish("outTopic", "hello world");
-      // ... and resubscribe
-      client.subscribe("nova_skusobna_in");
-      client.subscribe("nova_skusobna_update");
+    lastResults = results;
+    tempFilter.Add(TempHumSesnor.GetTemperatureCenti());
+    humFilter.Add(TempHumSesnor.GetHumidityCenti());
+
+    // Sample faster while values move, slower while the room is stable
+    acquisition.Add(millis(), tempFilter.GetValue(), humFilter.GetValue());
+#ifndef SHT_PERIODIC_RATE
+    TempHumSesnor.SetShotInterval(acquisition.GetIntervalMs());
+#endif
+  }
+}
+
+TelemetrySample takeSample()
+{
+  TelemetrySample sample;
+
+  // Values stay in fixed point from the sensor to the payload
+  sample.iTimestamp = millis();
+  sample.iTempValid = TempHumSesnor.IsValid() && tempFilter.IsPrimed();
+  sample.iHumValid = TempHumSesnor.IsValid() && humFilter.IsPrimed();
+  sample.iTempCenti = tempFilter.GetValue();
+  sample.iHumCenti = humFilter.GetValue();
+  sample.iMovement = MotSensor.IsMovement();
+
+  // Filled in by the network task, which owns Wi-Fi
+  sample.iRssi = 0;
+
+  return sample;
+}
+
+void queueReport(const TelemetrySample &sample)
+{
+  TelemetryReport report = {};
+
+  // Windows close with every report, so each report aggregates its own interval
+  report.iSample = sample;
+  if (reportWindows)
+  {
+    report.iTempWindow = tempFilter.TakeWindow();
+    report.iHumWindow = humFilter.TakeWindow();
+  }
+  report.iIntervalMs = TempHumSesnor.GetIntervalMs();
+
+  // Overflows are counted by the queue and published with task metrics
+  reportQueue.Push(report);
+}
+
+void addWindow(JsonDocument &doc, const char *key, const WindowRecord &window)
+{
+  // [count, min, max, mean, stddev, rejected], 0.01 of the unit
+  JsonArray entry = doc.createNestedArray(key);
+  entry.add(window.iCount);
+  entry.add(window.iMin);
+  entry.add(window.iMax);
+  entry.add(window.iMean);
+  entry.add(window.iStdDev);
+  entry.add(window.iRejected);
+}
+
+bool publishJson(const TelemetryReport &report)
+{
+  const TelemetrySample &sample = report.iSample;
+  StaticJsonDocument<384> doc;
+  char temp[12];
+  char hum[12];
+
+  // Decimal text is formatted from fixed point, ArduinoJson copies it verbatim
+  if (sample.iTempValid && TelemetryCodec::FormatCenti(sample.iTempCenti, temp, sizeof temp))
+  {
+    doc["temp"] = serialized(temp);
+  }
+  else
+  {
+    doc["temp"] = INVALID_TEMPERATURE;
+  }
+
+  if (sample.iHumValid && TelemetryCodec::FormatCenti(sample.iHumCenti, hum, sizeof hum))
+  {
+    doc["hum"] = serialized(hum);
+  }
+  else
+  {
+    doc["hum"] = INVALID_HUMIDITY;
+  }
+
+  doc["movmnt"] = sample.iMovement;
+
+  doc["signl"] = sample.iRssi;
+
+  doc["version"] = FIRMWARE_VERSION;
+
+  doc["offln"] = mqtt.GetDisconnectedMs();
+  doc["loops"] = mqtt.GetIterations();
+  doc["acq_ms"] = report.iIntervalMs;
+
+  // One aggregate of the filtered results per reporting interval
+  addWindow(doc, "temp_win", report.iTempWindow);
+  addWindow(doc, "hum_win", report.iHumWindow);
+
+  serializeJson(doc, msg);
+  Serial.print("Publish message: ");
+  Serial.println(msg);
+
+  return mqtt.IsConnected() && client.publish("nova_skusobna_out", msg);
+}
+
+bool publishBinary(const TelemetrySample &sample)
+{
+  TelemetryRecord record;
+
+  record.iTempValid = sample.iTempValid;
+  record.iHumValid = sample.iHumValid;
+  record.iTempCenti = sample.iTempCenti;
+  record.iHumCenti = sample.iHumCenti;
+  record.iMovement = sample.iMovement;
+  record.iRssi = sample.iRssi;
+  record.iVersionMajor = FIRMWARE_VERSION_MAJOR;
+  record.iVersionMinor = FIRMWARE_VERSION_MINOR;
+  record.iOfflineMs = mqtt.GetDisconnectedMs();
 
+  const size_t size = TelemetryCodec::Encode(record, (uint8_t*)msg, sizeof msg);
+  Serial.printf("Publish binary message, %u bytes\n", (unsigned)size);
+
+  return mqtt.IsConnected() && client.publish("nova_skusobna_out_bin", (const uint8_t*)msg, size);
+}
+
+void publishBatch()
+{
+  TelemetrySample samples[SAMPLE_BATCH_CAPACITY];
+  // Samples buffered while the broker was down may not fit one message, the rest goes with the next one
+  const uint8_t count = batch.Peek(samples, (BATCH_BUFFER_SAMPLES < SAMPLE_BATCH_CAPACITY) ? BATCH_BUFFER_SAMPLES : SAMPLE_BATCH_CAPACITY);
+  bool published;
+
+#ifdef TELEMETRY_BINARY
+  const size_t size = TelemetryCodec::EncodeBatch(samples, count, FIRMWARE_VERSION_MAJOR, FIRMWARE_VERSION_MINOR,
+                                                   (uint8_t*)batchMsg, sizeof batchMsg);
+  published = (size != 0) && client.publish("nova_skusobna_out_bin", (const uint8_t*)batchMsg, size);
+#else
+  // Samples are [ms since previous, temp 0.01 degC, hum 0.01 %, movement, rssi]
+  DynamicJsonDocument doc(JSON_OBJECT_SIZE(4) + JSON_ARRAY_SIZE(SAMPLE_BATCH_CAPACITY) + SAMPLE_BATCH_CAPACITY * JSON_ARRAY_SIZE(5));
+  doc["version"] = FIRMWARE_VERSION;
+  doc["t0"] = samples[0].iTimestamp;
+  doc["dropped"] = batch.GetDropped();
+  JsonArray entries = doc.createNestedArray("s");
+
+  uint32_t previous = samples[0].iTimestamp;
+  for (uint8_t idx = 0; idx < count; ++idx)
+  {
+    JsonArray entry = entries.createNestedArray();
+    entry.add(samples[idx].iTimestamp - previous);
+    entry.add(samples[idx].iTempCenti);
+    entry.add(samples[idx].iHumCenti);
+    entry.add(samples[idx].iMovement ? 1 : 0);
+    entry.add(samples[idx].iRssi);
+    previous = samples[idx].iTimestamp;
+  }
+
+  // Truncated JSON is never published, the samples stay buffered
+  const size_t size = (measureJson(doc) < sizeof batchMsg) ? serializeJson(doc, batchMsg, sizeof batchMsg) : 0;
+  published = (size != 0) && client.publish("nova_skusobna_out_batch", batchMsg);
+#endif
+
+  // Samples stay buffered for the next flush if the broker did not take them
+  if (!published)
+  {
+    Serial.printf("Batch of %u samples not published, kept for retry\n", count);
+    return;
+  }
+
+  batch.Discard(count);
+  Serial.printf("Published batch of %u samples, %u bytes\n", count, (unsigned)size);
+}
+
+void publishMotionEvent(const InterruptEvent &event)
+{
+  char payload[64];
+
+  // Latency from the edge to the publish, lets the backend judge event freshness
+  snprintf(payload, sizeof payload, "{\"movmnt\":true,\"lat_us\":%u}", (unsigned)(micros() - event.iTimestamp));
+
+  if (mqtt.IsConnected())
+  {
+    client.publish("nova_skusobna_motion", payload);
+  }
+}
+
+void publishTaskMetrics()
+{
+  char payload[320];
+  const SpoolStats &spooled = spool.GetStats();
+  const TaskMetrics acq = acquisitionTask.GetMetrics();
+  const TaskMetrics net = networkTask.GetMetrics();
+
+  // [load per mille, longest iteration us, longest job lateness us, free stack bytes] per task,
+  // [high water, overflows] per queue, [pending, spooled, replayed, dropped, corrupt] of the spool,
+  // [steps served, steps while disconnected] of the MQTT connection
+  snprintf(payload, sizeof payload,
+    "{\"acq\":[%u,%u,%u,%u],\"net\":[%u,%u,%u,%u],\"rep_q\":[%u,%u],\"mot_q\":[%u,%u],\"spool\":[%u,%u,%u,%u,%u],\"mqtt\":[%u,%u]}",
+    acq.iLoadPermille, acq.iMaxBusyUs, acquisitionJobs.GetMaxLatenessUs(), acq.iStackFreeBytes,
+    net.iLoadPermille, net.iMaxBusyUs, networkJobs.GetMaxLatenessUs(), net.iStackFreeBytes,
+    reportQueue.GetHighWater(), reportQueue.GetOverflows(),
+    motionQueue.GetHighWater(), motionQueue.GetOverflows(),
+    spool.GetPending(), spooled.iSpooled, spooled.iReplayed, spooled.iDropped, spooled.iCorrupt,
+    mqtt.GetIterations(), mqtt.GetOfflineIterations());
+
+  if (mqtt.IsConnected())
+  {
+    client.publish("nova_skusobna_tasks", payload);
+  }
+}
+
+void reportSample(const TelemetryReport &report)
+{
+  const TelemetrySample &sample = report.iSample;
+
+  // Outages go to flash instead of being lost, the replay job sends them later
+  if (!mqtt.IsConnected())
+  {
+    spool.Push(sample);
+    return;
+  }
+
+  if (batch.IsDisabled())
+  {
+#ifdef TELEMETRY_BINARY
+    const bool published = publishBinary(sample);
+#else
+    const bool published = publishJson(report);
+#endif
+
+    // E.g. the link dropped since the check above or the message did not fit
+    if (!published)
+    {
+      spool.Push(sample);
     }
-    else
+  }
+  else
+  {
+    // A sample past the age limit starts the next batch, so no batch spans more than the limit
+    if (batch.IsFlushDue(sample.iTimestamp))
     {
-      Serial.print("failed, rc=");
-      Serial.print(client.state());
-      Serial.println(" try again in 5 seconds");
-      // Wait 5 seconds before retrying
-      delay(5000);
+      publishBatch();
     }
+
+    batch.Push(sample);
+
+    if (batch.IsFlushDue(sample.iTimestamp))
+    {
+      publishBatch();
+    }
+  }
+}
+
+void runReplay()
+{
+  SpoolRecord records[SPOOL_REPLAY_BURST];
+
+  if (!mqtt.IsConnected() || (spool.GetPending() == 0))
+  {
+    return;
+  }
+
+  const uint8_t count = spool.Peek(records, SPOOL_REPLAY_BURST);
+
+  if (count == 0)
+  {
+    // Only corrupt records were read, they are skipped
+    spool.Commit();
+    return;
+  }
+
+  // Samples are [seq, boot, ms, temp 0.01 degC, hum 0.01 %, flags], ms are
+  // millis() of their boot, so only those of the current boot relate to now
+  DynamicJsonDocument doc(JSON_OBJECT_SIZE(4) + JSON_ARRAY_SIZE(SPOOL_REPLAY_BURST) + SPOOL_REPLAY_BURST * JSON_ARRAY_SIZE(6));
+  doc["version"] = FIRMWARE_VERSION;
+  doc["boot"] = bootId;
+  doc["now"] = millis();
+  JsonArray entries = doc.createNestedArray("s");
+
+  for (uint8_t idx = 0; idx < count; ++idx)
+  {
+    JsonArray entry = entries.createNestedArray();
+    entry.add(records[idx].iSeq);
+    entry.add(records[idx].iBootId);
+    entry.add(records[idx].iTimestamp);
+    entry.add(records[idx].iTempCenti);
+    entry.add(records[idx].iHumCenti);
+    entry.add(records[idx].iFlags);
+  }
+
+  const size_t size = serializeJson(doc, batchMsg, sizeof batchMsg);
+
+  // Records stay spooled until the broker has taken them
+  if (client.publish("nova_skusobna_out_replay", batchMsg))
+  {
+    spool.Commit();
+    Serial.printf("Replayed %u spooled samples, %u bytes, %u left\n", count, (unsigned)size, (unsigned)spool.GetPending());
+  }
+}
+
+bool publishSampleLog(const uint32_t wifiMs)
+{
+  // Samples are [age s, temp 0.01 degC, hum 0.01 %, flags], seq0 numbers the oldest one
+  DynamicJsonDocument doc(JSON_OBJECT_SIZE(12) + JSON_ARRAY_SIZE(RTC_LOG_CAPACITY) + RTC_LOG_CAPACITY * JSON_ARRAY_SIZE(4));
+  const SleepStats &stats = sleepCycle.GetStats();
+  const uint32_t now = time(nullptr);
+
+  doc["version"] = FIRMWARE_VERSION;
+  doc["seq0"] = sampleLog.GetFirstSeq();
+  doc["dropped"] = sampleLog.iDropped;
+  doc["signl"] = WiFi.RSSI();
+  doc["wake"] = DeepSleepCycle::GetWakeCauseName(sleepCycle.GetWakeCause());
+  doc["cycle"] = stats.iCycles;
+  doc["failed"] = stats.iFailedCycles;
+  doc["wifi_ms"] = wifiMs;
+  doc["awake_ms"] = sleepCycle.GetAwakeMs();
+
+  // Awake time of the previous cycle is known only now, the current one ends in sleep
+  doc["last_awake_ms"] = stats.iLastAwakeMs;
+  JsonArray entries = doc.createNestedArray("s");
+
+  for (uint8_t idx = 0; idx < sampleLog.GetCount(); ++idx)
+  {
+    const LoggedSample &sample = sampleLog.Get(idx);
+    JsonArray entry = entries.createNestedArray();
+    entry.add(now - sample.iTimeS);
+    entry.add(sample.iTempCenti);
+    entry.add(sample.iHumCenti);
+    entry.add(sample.iFlags);
+  }
+
+  const size_t size = serializeJson(doc, batchMsg, sizeof batchMsg);
+  Serial.printf("Flushing %u logged samples, %u bytes\n", sampleLog.GetCount(), (unsigned)size);
+
+  return mqtt.IsConnected() && client.publish("nova_skusobna_out_log", batchMsg);
+}
+
+void runBatteryCycle()
+{
+  sleepCycle.Begin();
+
+  i2cBuses.Begin(0, 21, 22, SHT_I2C_FREQUENCY_HZ);
+  i2cBuses.Add(TempHumSesnor);
+
+  const bool movement = (sleepCycle.GetWakeCause() == eWakeMotion) || MotSensor.IsMovement();
+
+  // Most wake-ups only measure, so the measurement does not wait for the radio
+  const uint32_t sensorStart = millis();
+  do
+  {
+    i2cBuses.Update();
+    delay(1);
+  } while ((TempHumSesnor.GetStats().iResults == 0) && (millis() - sensorStart < BATTERY_SENSOR_TIMEOUT_MS));
+
+  const bool valid = TempHumSesnor.GetStats().iResults != 0;
+  LoggedSample sample;
+  sample.iTimeS = time(nullptr);
+  sample.iTempCenti = TempHumSesnor.GetTemperatureCenti();
+  sample.iHumCenti = TempHumSesnor.GetHumidityCenti();
+  sample.iFlags = (movement ? RTC_LOG_MOVEMENT : 0) | (valid ? RTC_LOG_TEMP_VALID | RTC_LOG_HUM_VALID : 0);
+  sampleLog.Add(sample);
+
+  // Radio-on time dominates the battery budget, it is spent only when the log is due
+  const FlushPolicy policy = {BATTERY_FLUSH_WAKES, BATTERY_FLUSH_TEMP, BATTERY_FLUSH_HUM};
+  if (!sampleLog.IsFlushDue(policy, sleepCycle.GetWakeCause() != eWakeTimer))
+  {
+    sleepCycle.Sleep(true);
+  }
+
+  if (!wifi.Connect(ssid.c_str(), password.c_str()))
+  {
+    sampleLog.FlushDone(false);
+    sleepCycle.Sleep(false);
+  }
+  const uint32_t wifiMs = wifi.GetConnectTimeMs();
+
+  client.setServer(mqtt_server.c_str(), 1883);
+  client.setBufferSize(BATCH_BUFFER_SIZE + 64);
+  mqtt.SetCredentials("nova_skusobna", mqtt_name.c_str(), mqtt_password.c_str());
+
+  const uint32_t mqttStart = millis();
+  while (!mqtt.IsConnected() && (millis() - mqttStart < BATTERY_MQTT_TIMEOUT_MS))
+  {
+    mqtt.Step();
+  }
+
+  // A QoS 0 publish is not acknowledged and disconnect() closes the socket right
+  // after sending DISCONNECT, so the log gets time to leave before the radio goes down
+  const bool published = publishSampleLog(wifiMs);
+  const uint32_t drainStart = millis();
+  while (published && mqtt.IsConnected() && (millis() - drainStart < BATTERY_PUBLISH_DRAIN_MS))
+  {
+    client.loop();
+    delay(10);
   }
+  client.disconnect();
+
+  sampleLog.FlushDone(published);
+  sleepCycle.Sleep(published);
 }
 
 void setup()
@@ -193,56 +1018,197 @@ void setup()
   Serial.printf("Version 2.2\n");
   EEPROM.begin(512);
 
+  ssid = "Jakubcata & BW";//read_String(0);
+  password = "NaJednejCeste";//read_String(30);
   mqtt_server = "mqtt.faravent.jakubcata.eu";//read_String(60);
   mqtt_name = "jakubcata";//read_String(100);
   mqtt_password = "jakubcata2005";//read_String(130);
+
+#ifdef BATTERY_MODE
+  // Never returns, the cycle ends in deep sleep and the next one boots again
+  runBatteryCycle();
+#endif
+
   setup_wifi();
   client.setServer(mqtt_server.c_str(), 1883);
   client.setCallback(callback);
+  ESPhttpUpdate.onProgress(reportUpdateProgress);
+  ESPhttpUpdate.rebootOnUpdate(false);
+  client.setBufferSize(BATCH_BUFFER_SIZE + 64);
+  mqtt.SetCredentials("nova_skusobna", mqtt_name.c_str(), mqtt_password.c_str());
+  MotSensor.EnableInterrupt();
+
+  // Samples spooled before a reboot are replayed as well
+  bootId = esp_random();
+  if (SPIFFS.begin(true))
+  {
+    Serial.printf("Spooled samples: %u\n", (unsigned)spool.Begin(bootId));
+  }
+
+  // Sensors sharing the buses are stepped by the bus manager in the acquisition task
+  i2cBuses.Begin(0, 21, 22, SHT_I2C_FREQUENCY_HZ);
+  i2cBuses.Add(TempHumSesnor);
+#ifdef SHT_PERIODIC_RATE
+  TempHumSesnor.StartPeriodic(SHT_PERIODIC_RATE);
+#else
+  TempHumSesnor.SetShotInterval(acquisition.GetIntervalMs());
+#endif
+
+  // Every activity is a job, a task sleeps until the earliest deadline of its jobs
+  sensorJob = acquisitionJobs.AddOneShot("sensor", runSensor, 0);
+  acquisitionJobs.AddPeriodic("motion", runMotion, MOTION_JOB_PERIOD_US);
+  acquisitionJobs.AddPeriodic("led", runLed, LED_JOB_PERIOD_US);
+  acquisitionJobs.AddPeriodic("settings", runSettings, SETTINGS_JOB_PERIOD_US);
+  reportJob = acquisitionJobs.AddPeriodic("report", runReport,
+    (changeDetector.IsEnabled() ? CHANGE_CHECK_PERIOD_MS : samplePeriodMs) * 1000);
+
+  networkJobs.AddPeriodic("mqtt", runMqtt, MQTT_JOB_PERIOD_US);
+  networkJobs.AddPeriodic("publish", runPublish, PUBLISH_JOB_PERIOD_US);
+  networkJobs.AddPeriodic("replay", runReplay, REPLAY_JOB_PERIOD_US);
+  networkJobs.AddPeriodic("metrics", publishTaskMetrics, METRICS_JOB_PERIOD_US, METRICS_JOB_PERIOD_US);
+
+  // Slow publishes, reconnects and OTA on core 0 no longer hold up sensor reads on core 1
+  if (!acquisitionTask.Start() || !networkTask.Start() || !updateTask.Start())
+  {
+    Serial.println("Task creation failed");
+    ESP.restart();
+  }
 }
 
-void loop()
+void runSensor()
 {
-    static uint64_t timestamp;
+  i2cBuses.Update();
+  filterResults();
+
+  // Runs again once a sensor needs the bus, e.g. when its measurement is done
+  acquisitionJobs.SetDeadline(sensorJob, i2cBuses.GetDeadlineUs(TASK_MAX_SLEEP_US));
+}
 
-    if (!client.connected())
+void runMotion()
+{
+  // Motion starts posted by ISRs go to the network task for publishing
+  InterruptEvent event;
+  while (Interrupt::PollEvent(event))
+  {
+    if ((event.iSource == MOTION_INTERRUPT_NUMBER) && event.iData)
     {
-      reconnect();
+      motionQueue.Push(event);
     }
-    client.loop();
+  }
+}
 
+void runLed()
+{
+  digitalWrite( BUILTIN_LED, !MotSensor.IsMovement() );
+}
 
-    // Do update of the sensor data
-    TempHumSesnor.Update();
+void runSettings()
+{
+  AcquisitionSettings update;
+  if (settingsQueue.Pop(update))
+  {
+    applySettings(update);
+  }
+}
 
-    digitalWrite( BUILTIN_LED, !MotSensor.IsMovement() );
+void runReport()
+{
+  const TelemetrySample sample = takeSample();
 
-    uint64_t now = millis();
-    if (now - timestamp >= 2000)
-    {   
+  // Significant changes go out right away, heartbeat keeps stable rooms visible
+  if (!changeDetector.IsEnabled() || changeDetector.Evaluate(sample))
+  {
+    queueReport(sample);
+  }
+}
 
+void runMqtt()
+{
+  // Never blocks longer than one connect attempt, sampling keeps running on the other core
+  mqtt.Step();
+}
 
-        timestamp = now;
+void runPublish()
+{
+  UpdateStatus status;
+  while (updateStatusQueue.Pop(status))
+  {
+    publishUpdateStatus(status);
+  }
 
-        Serial.println("500ms elapsed!");
+  InterruptEvent event;
+  while (motionQueue.Pop(event))
+  {
+    publishMotionEvent(event);
+  }
 
-        Serial.print("Temperature: ");
-        Serial.println( TempHumSesnor.GetTemperature() );
-        Serial.print("Humidity: ");
-        Serial.println( TempHumSesnor.GetHumidity() );
-        StaticJsonDocument<200> doc;
-        doc["temp"] = TempHumSesnor.GetTemperature();
-        doc["hum"] = TempHumSesnor.GetHumidity();
+  TelemetryReport report;
+  while (reportQueue.Pop(report))
+  {
+    report.iSample.iRssi = WiFi.RSSI();
+    reportSample(report);
+  }
+}
 
-        doc["movmnt"] = MotSensor.IsMovement(); 
+uint32_t acquisitionStep()
+{
+  return acquisitionJobs.Run(TASK_MAX_SLEEP_US);
+}
 
-        doc["signl"] = WiFi.RSSI();
+uint32_t networkStep()
+{
+  return networkJobs.Run(TASK_MAX_SLEEP_US);
+}
+
+uint32_t updateStep()
+{
+  UpdateRequest request;
+  if (!updateQueue.Pop(request))
+  {
+    return OTA_POLL_US;
+  }
+
+  t_httpUpdate_return ret = ESPhttpUpdate.update(request.iHost, 80, request.iPath);
+  UpdateStatus status = makeUpdateStatus(eUpdateFailed, ESPhttpUpdate.getStats());
+
+  switch (ret)
+  {
+  case HTTP_UPDATE_FAILED:
+    // A kept partial image lets the next request for the same image resume
+    status.iError = ESPhttpUpdate.getLastError();
+    snprintf(status.iMessage, sizeof status.iMessage, "%s", ESPhttpUpdate.getLastErrorString().c_str());
+    Serial.printf("HTTP_UPDATE_FAILD Error (%d): %s, resumable at %u\n", ESPhttpUpdate.getLastError(),
+      ESPhttpUpdate.getLastErrorString().c_str(), ESPhttpUpdate.getResumeOffset());
+    break;
+  case HTTP_UPDATE_NO_UPDATES:
+    status.iState = eUpdateNoUpdate;
+    Serial.println("HTTP_UPDATE_NO_UPDATES");
+    break;
+  case HTTP_UPDATE_OK:
+    status.iState = eUpdateOk;
+    Serial.println("HTTP_UPDATE_OK");
+    break;
+  }
 
-        doc["version"] = "0.4";
+  // Status is lost only if the queue stays full, the backend sees the reboot anyway
+  updateStatusQueue.Push(status);
 
-        serializeJson(doc, msg);
-        Serial.print("Publish message: ");
-        Serial.println(msg);
-        client.publish("nova_skusobna_out", msg);
+  if (ret == HTTP_UPDATE_OK)
+  {
+    // The network task publishes the result before the reboot
+    const uint32_t start = millis();
+    while ((updateStatusQueue.GetCount() != 0) && (millis() - start < OTA_STATUS_FLUSH_MS))
+    {
+      delay(10);
     }
-}
\ No newline at end of file
+    ESP.restart();
+  }
+
+  return 0;
+}
+
+void loop()
+{
+  // All work runs in the pinned tasks, the Arduino loop task is not needed
+  vTaskDelete(nullptr);
+}